@@ -2,4 +2,15 @@ TEMPLATE = subdirs
 
 SUBDIRS += \
     cgds \
-    test
+    test \
+    test/lazyopen \
+    test/real8 \
+    test/snapshot \
+    test/rectboundary \
+    test/tilerender \
+    test/parallelread \
+    test/parallelwrite \
+    test/swapbytes \
+    test/transform \
+    test/rtree \
+    test/query
@@ -19,20 +19,56 @@
  * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
  **/
 
-#include <QtGui/QTransform>
 #include <assert.h>
+#include <algorithm>
 #include "aref.h"
 #include <sstream>
 #include "gdsio.h"
 #include "structures.h"
+#include "transform.h"
 
 namespace GDS
 {
 
-ARef::ARef() :Element(AREF)
+// Range [first, last] of k for which [a + k * pitch, b + k * pitch]
+// intersects [lo, hi], with 0 <= k < count. Empty when first > last.
+static void LatticeRange(long long lo, long long hi, long long a, long long b,
+						 long long pitch, int count, int &first, int &last)
+{
+	auto floor_div = [](long long n, long long d) {
+		long long q = n / d;
+		return (n % d != 0 && ((n < 0) != (d < 0))) ? q - 1 : q;
+	};
+	auto ceil_div = [&](long long n, long long d) { return -floor_div(-n, d); };
+	long long k0, k1;
+	if (pitch > 0)
+	{
+		k0 = ceil_div(lo - b, pitch);
+		k1 = floor_div(hi - a, pitch);
+	}
+	else if (pitch < 0)
+	{
+		k0 = ceil_div(hi - a, pitch);
+		k1 = floor_div(lo - b, pitch);
+	}
+	else
+	{
+		k0 = 0;
+		k1 = (a <= hi && b >= lo) ? count - 1 : -1;
+	}
+	first = int(std::max(k0, 0LL));
+	last = int(std::min(k1, (long long)count - 1));
+}
+
+ARef::ARef() :ARef(std::pmr::get_default_resource())
+{
+}
+
+ARef::ARef(std::pmr::memory_resource *resource) :Element(AREF), Pts(resource)
 {
 	Eflags = 0;
-	SName = "";
+	Names = NameTable::detached().get();
+	SName = 0;
 	Strans = 0;
 	Row = 0;
 	Col = 0;
@@ -45,11 +81,21 @@ ARef::~ARef()
 {
 }
 
-std::string ARef::structName() const
+const std::string &ARef::structName() const
+{
+	return Names->name(SName);
+}
+
+NameId ARef::structId() const
 {
 	return SName;
 }
 
+NameTable *ARef::names() const
+{
+	return Names;
+}
+
 short ARef::row() const
 {
 	return Row;
@@ -62,7 +108,12 @@ short ARef::col() const
 
 std::vector<Point> ARef::xy() const
 {
-	return Pts;
+	return std::vector<Point>(Pts.begin(), Pts.end());
+}
+
+PointView ARef::points() const
+{
+	return PointView(Pts.data(), Pts.size());
 }
 
 double ARef::angle() const
@@ -85,9 +136,15 @@ bool ARef::stransFlag(STRANS_FLAG flag) const
     return (Strans & flag) != 0;
 }
 
-void ARef::set_struct_name(std::string name)
+void ARef::set_struct_name(std::string_view name)
 {
-	SName = name;
+	SName = Names->intern(name);
+}
+
+void ARef::set_struct_id(NameTable *names, NameId id)
+{
+	Names = names;
+	SName = id;
 }
 
 void ARef::set_row_col(int row, int col)
@@ -98,7 +155,17 @@ void ARef::set_row_col(int row, int col)
 
 void ARef::set_xy(std::vector<Point> pts)
 {
-	Pts = pts;
+	Pts.assign(pts.begin(), pts.end());
+}
+
+void ARef::set_xy(PointArray &&pts)
+{
+	Pts = std::move(pts);
+}
+
+void ARef::set_xy(std::initializer_list<Point> pts)
+{
+	Pts.assign(pts.begin(), pts.end());
 }
 
 void ARef::set_angle(double angle)
@@ -126,6 +193,39 @@ void ARef::set_reference(std::shared_ptr<Structure> ref)
 	ReferTo = ref;
 }
 
+bool ARef::placement_range(const Box &window, const Box &base, int &row_first, int &row_last,
+						   int &col_first, int &col_last) const
+{
+	row_first = col_first = 0;
+	row_last = col_last = -1;
+	if (Pts.size() != 3 || Row <= 0 || Col <= 0)
+		return true;
+	row_last = Row - 1;
+	col_last = Col - 1;
+	int row_pitch_x = (Pts[2].x - Pts[0].x) / Row;
+	int row_pitch_y = (Pts[2].y - Pts[0].y) / Row;
+	int col_pitch_x = (Pts[1].x - Pts[0].x) / Col;
+	int col_pitch_y = (Pts[1].y - Pts[0].y) / Col;
+	long long lx = window.x, hx = (long long)window.x + window.w;
+	long long ly = window.y, hy = (long long)window.y + window.h;
+	long long ax = (long long)base.x + Pts[0].x, bx = ax + base.w;
+	long long ay = (long long)base.y + Pts[0].y, by = ay + base.h;
+	// Rows and columns each move along one axis: the range is exact.
+	if (row_pitch_x == 0 && col_pitch_y == 0)
+	{
+		LatticeRange(ly, hy, ay, by, row_pitch_y, Row, row_first, row_last);
+		LatticeRange(lx, hx, ax, bx, col_pitch_x, Col, col_first, col_last);
+		return true;
+	}
+	if (row_pitch_y == 0 && col_pitch_x == 0)
+	{
+		LatticeRange(lx, hx, ax, bx, row_pitch_x, Row, row_first, row_last);
+		LatticeRange(ly, hy, ay, by, col_pitch_y, Col, col_first, col_last);
+		return true;
+	}
+	return false;
+}
+
 bool ARef::bbox(int &x, int &y, int &w, int &h) const
 {
     if (ReferTo.expired())
@@ -136,37 +236,33 @@ bool ARef::bbox(int &x, int &y, int &w, int &h) const
         return false;
 
     assert(Pts.size() == 3);
-    QRect ref_rect(ref_x, ref_y, ref_w, ref_h);
     int row_pitch_x = (Pts[2].x - Pts[0].x) / row();
     int row_pitch_y = (Pts[2].y - Pts[0].y) / row();
     int col_pitch_x = (Pts[1].x - Pts[0].x) / col();
     int col_pitch_y = (Pts[1].y - Pts[0].y) / col();
-    QTransform reflect_transform, mag_transform, rotate_transform;
-    if (stransFlag(REFLECTION))
-        reflect_transform.scale(1, -1);
-    mag_transform.scale(mag(), mag());
-    rotate_transform.rotate(angle());
-    QTransform shift_transform[] = {
-        QTransform().translate(Pts[0].x, Pts[0].y),
-        QTransform().translate(Pts[0].x + col_pitch_x * (col() - 1),
-                               Pts[0].y + col_pitch_y * (col() - 1)),
-        QTransform().translate(Pts[0].x + row_pitch_x * (row() - 1),
-                               Pts[0].y + row_pitch_y * (row() - 1)),
-        QTransform().translate(Pts[0].x + row_pitch_x * (row() - 1) + col_pitch_x * (col() - 1),
-                               Pts[0].y + row_pitch_y * (row() - 1) + col_pitch_y * (col() - 1))
+    // The instances differ only by their offset, so map the box once and
+    // shift it to the four corners of the lattice.
+    Transform transform(Point(0, 0), mag(), angle(), stransFlag(REFLECTION));
+    transform.mapBox(ref_x, ref_y, ref_w, ref_h);
+    Point corners[] = {
+        Point(Pts[0].x, Pts[0].y),
+        Point(Pts[0].x + col_pitch_x * (col() - 1),
+              Pts[0].y + col_pitch_y * (col() - 1)),
+        Point(Pts[0].x + row_pitch_x * (row() - 1),
+              Pts[0].y + row_pitch_y * (row() - 1)),
+        Point(Pts[0].x + row_pitch_x * (row() - 1) + col_pitch_x * (col() - 1),
+              Pts[0].y + row_pitch_y * (row() - 1) + col_pitch_y * (col() - 1))
     };
     int llx = GDS_MAX_INT;
     int lly = GDS_MAX_INT;
     int urx = GDS_MIN_INT;
     int ury = GDS_MIN_INT;
-    for (size_t i = 0; i < 3; i++)
+    for (size_t i = 0; i < 4; i++)
     {
-        QTransform transform = reflect_transform * mag_transform * rotate_transform * shift_transform[i];
-        QRect map_rect = transform.mapRect(ref_rect);
-        llx = map_rect.x() < llx ? map_rect.x() : llx;
-        lly = map_rect.y() < lly ? map_rect.y() : lly;
-        urx = map_rect.x() + map_rect.width() > urx ? map_rect.x() + map_rect.width() : urx;
-        ury = map_rect.y() + map_rect.height() > ury ? map_rect.y() + map_rect.height() : ury;
+        llx = std::min(llx, corners[i].x + ref_x);
+        lly = std::min(lly, corners[i].y + ref_y);
+        urx = std::max(urx, corners[i].x + ref_x + ref_w);
+        ury = std::max(ury, corners[i].y + ref_y + ref_h);
     }
     x = llx;
     y = lly;
@@ -176,7 +272,7 @@ bool ARef::bbox(int &x, int &y, int &w, int &h) const
 	return true;
 }
 
-int ARef::read(std::ifstream &in, std::string &msg)
+int ARef::read(Reader &in, std::string &msg)
 {
 	bool finished = false;
 	while (!finished)
@@ -215,8 +311,9 @@ int ARef::read(std::ifstream &in, std::string &msg)
 				msg = ss.str();
 				return FORMAT_ERROR;
 			}
-			if (!readString(in, record_size - 4, SName))
+			if (!readName(in, record_size - 4, SName))
 				return FILE_ERROR;
+			Names = in.name_table().get();
 			break;
 		case XY:
 			if (record_size != 28)
@@ -228,14 +325,8 @@ int ARef::read(std::ifstream &in, std::string &msg)
 				msg = ss.str();
 				return FORMAT_ERROR;
 			}
-			for (int i = 0; i < 3; i++)
-			{
-				int x, y;
-				if (!readInteger(in, x)
-					|| !readInteger(in, y))
-					return FILE_ERROR;
-				Pts.push_back(Point(x, y));
-			}
+			if (!readPoints(in, 3, Pts))
+				return FILE_ERROR;
 			break;
 		case STRANS:
 			if (record_size != 6)
@@ -297,7 +388,7 @@ int ARef::read(std::ifstream &in, std::string &msg)
 	return 0;
 }
 
-int ARef::write(std::ofstream &out, std::string &msg)
+int ARef::write(Writer &out, std::string &msg)
 {
 	short record_size;
 
@@ -313,13 +404,14 @@ int ARef::write(std::ofstream &out, std::string &msg)
 	writeByte(out, Integer_2);
 	writeShort(out, Eflags);
 
-    record_size = 4 + short(SName.size());
+	const std::string &sname = Names->name(SName);
+    record_size = 4 + short(sname.size());
 	if (record_size % 2 != 0)
 		record_size += 1;
 	writeShort(out, record_size);
 	writeByte(out, SNAME);
 	writeByte(out, String);
-	writeString(out, SName);
+	writeString(out, sname);
 
 	record_size = 6;
 	writeShort(out, record_size);
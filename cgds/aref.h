@@ -23,6 +23,7 @@
 #define AREF_H
 #include <memory>
 #include "elements.h"
+#include "names.h"
 
 namespace GDS {
 class Structure;
@@ -42,40 +43,85 @@ class Structure;
 	*/
 class ARef : public Element {
 	short               Eflags;
-	std::string         SName;
+	NameTable          *Names;
+	NameId              SName;
 	short               Strans;
 	short               Row, Col;
-	std::vector<Point>  Pts;
+	PointArray          Pts;
 	double              Angle;
 	double              Mag;
 	std::weak_ptr<Structure> ReferTo;
 
 public:
 	ARef();
+	/*!
+		* Construct with the points allocated from the given memory resource.
+		*/
+	explicit ARef(std::pmr::memory_resource *resource);
 	virtual ~ARef();
 
-	std::string structName() const;
+	const std::string &structName() const;
+	/*!
+		* The interned name of the referenced structure, an index into
+		* names().
+		*/
+	NameId structId() const;
+	NameTable *names() const;
 	short row() const;
 	short col() const;
 	std::vector<Point> xy() const;
+	/*!
+		* The points without copying them, see PointView.
+		*/
+	PointView points() const;
 	double angle() const;
 	double mag() const;
 	short strans() const;
 	bool stransFlag(STRANS_FLAG flag) const;
 	virtual bool bbox(int &x, int &y, int &w, int &h) const;
+	/*!
+		* The placements whose box may intersect a window: rows [row_first,
+		* row_last] and columns [col_first, col_last]. Empty when a first is
+		* greater than its last.
+		*
+		* \param [in] window	The window, in the coordinates of the AREF.
+		* \param [in] base		The box of the referenced structure, transformed
+		*						by the magnification, angle and reflection.
+		*
+		* \return	true if every placement in the range intersects the window,
+		*			i.e. the lattice is axis-aligned. Otherwise the range is the
+		*			whole array and each placement must be tested.
+		*/
+	bool placement_range(const Box &window, const Box &base, int &row_first, int &row_last,
+						 int &col_first, int &col_last) const;
     std::shared_ptr<Structure> reference() { return ReferTo.lock(); }
 
-    void set_struct_name(std::string name);
+	/*!
+		* Refer to a structure by name. The name is interned in the table
+		* of the reference, or in NameTable::detached() for a new one.
+		*/
+    void set_struct_name(std::string_view name);
+	/*!
+		* Refer to a structure by interned name. The table must outlive the
+		* reference, e.g. the table of the library holding it.
+		*/
+	void set_struct_id(NameTable *names, NameId id);
     void set_row_col(int row,  int col);
     void set_xy(std::vector<Point> pts);
+	/*!
+		* Take over the points. Their storage is kept when it comes from the
+		* same memory resource as the AREF, see Structure::set_arena().
+		*/
+	void set_xy(PointArray &&pts);
+	void set_xy(std::initializer_list<Point> pts);
     void set_angle(double angle);
     void set_mag(double mag);
     void set_strans(short strans);
     void set_strans(STRANS_FLAG flag, bool enable = true);
     void set_reference(std::shared_ptr<Structure> ref);
 
-	virtual int read(std::ifstream &in, std::string &msg);
-	virtual int write(std::ofstream &out, std::string &msg);
+	virtual int read(Reader &in, std::string &msg);
+	virtual int write(Writer &out, std::string &msg);
 };
 
 }
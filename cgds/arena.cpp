@@ -0,0 +1,78 @@
+/*
+ * This file is part of GDSII.
+ *
+ * arena.cpp -- The file which implements the bulk storage of elements.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <cstdint>
+#include "arena.h"
+
+namespace GDS
+{
+
+Arena::Arena(size_t chunk_size)
+	: Chunk_size(chunk_size), Cursor(nullptr), End(nullptr), Used(0)
+{
+}
+
+Arena::~Arena()
+{
+}
+
+void *Arena::do_allocate(size_t bytes, size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	Used += bytes;
+	uintptr_t begin = (uintptr_t(Cursor) + alignment - 1) & ~uintptr_t(alignment - 1);
+	if (Cursor != nullptr && begin + bytes <= uintptr_t(End))
+	{
+		Cursor = (char *)(begin + bytes);
+		return (void *)begin;
+	}
+
+	// Requests above a quarter of a chunk would waste too much of it.
+	if (bytes + alignment > Chunk_size / 4)
+	{
+		Chunks.emplace_back(new char[bytes + alignment]);
+		uintptr_t start = uintptr_t(Chunks.back().get());
+		return (void *)((start + alignment - 1) & ~uintptr_t(alignment - 1));
+	}
+	Chunks.emplace_back(new char[Chunk_size]);
+	Cursor = Chunks.back().get();
+	End = Cursor + Chunk_size;
+	begin = (uintptr_t(Cursor) + alignment - 1) & ~uintptr_t(alignment - 1);
+	Cursor = (char *)(begin + bytes);
+	return (void *)begin;
+}
+
+void Arena::do_deallocate(void * /*p*/, size_t /*bytes*/, size_t /*alignment*/)
+{
+}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+	return this == &other;
+}
+
+size_t Arena::used()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Used;
+}
+
+}
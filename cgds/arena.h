@@ -0,0 +1,118 @@
+/*
+ * This file is part of GDSII.
+ *
+ * arena.h -- The header file which declare the bulk storage of elements.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef ARENA_H
+#define ARENA_H
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace GDS {
+
+/*!
+	* \brief Bump allocator handing out memory from large chunks.
+	*
+	* Deallocation does nothing; all the chunks are released together when
+	* the arena is destroyed. It is safe to allocate from several threads.
+	* The chunks have a fixed size, so at most one chunk is partly unused;
+	* large requests get a chunk of their own.
+	*/
+class Arena : public std::pmr::memory_resource {
+	std::mutex                            Mutex;
+	std::vector<std::unique_ptr<char[]> > Chunks;
+	size_t                                Chunk_size;
+	char                                  *Cursor;
+	char                                  *End;
+	size_t                                Used;
+
+protected:
+	virtual void *do_allocate(size_t bytes, size_t alignment);
+	virtual void do_deallocate(void *p, size_t bytes, size_t alignment);
+	virtual bool do_is_equal(const std::pmr::memory_resource &other) const noexcept;
+
+public:
+	/*!
+		* \param [in] chunk_size	Size of the chunks.
+		*/
+	explicit Arena(size_t chunk_size = 1 << 20);
+	virtual ~Arena();
+
+	/*!
+		* The number of bytes handed out so far.
+		*/
+	size_t used();
+};
+
+/*!
+	* Allocator of the control block and object of an element created by
+	* MakeElement(). It does not own the arena: the structure holding the
+	* element does, see Structure::set_arena().
+	*/
+template <class T>
+class ArenaAllocator {
+	Arena *Owner;
+
+public:
+	typedef T value_type;
+
+	explicit ArenaAllocator(Arena *arena) : Owner(arena) {}
+	template <class U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : Owner(other.arena()) {}
+
+	Arena *arena() const { return Owner; }
+
+	T *allocate(size_t n)
+	{
+		return static_cast<T *>(Owner->allocate(n * sizeof(T), alignof(T)));
+	}
+	void deallocate(T *p, size_t n)
+	{
+		Owner->deallocate(p, n * sizeof(T), alignof(T));
+	}
+
+	template <class U>
+	bool operator==(const ArenaAllocator<U> &other) const { return Owner == other.arena(); }
+	template <class U>
+	bool operator!=(const ArenaAllocator<U> &other) const { return Owner != other.arena(); }
+};
+
+/*!
+	* Create an element in the arena, or on the heap when there is none. The
+	* points of BOUNDARY, PATH and AREF elements go to the arena as well. The
+	* element must not outlive the arena.
+	*/
+template <class T>
+std::shared_ptr<T> MakeElement(Arena *arena)
+{
+	if (arena == nullptr)
+		return std::make_shared<T>();
+	if constexpr (std::is_constructible<T, std::pmr::memory_resource *>::value)
+		return std::allocate_shared<T>(ArenaAllocator<T>(arena),
+									   static_cast<std::pmr::memory_resource *>(arena));
+	else
+		return std::allocate_shared<T>(ArenaAllocator<T>(arena));
+}
+
+}
+
+#endif // ARENA_H
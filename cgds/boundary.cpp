@@ -20,7 +20,9 @@
  **/
 
 #include <limits>
+#include <algorithm>
 #include <assert.h>
+#include <new>
 #include "boundary.h"
 #include <sstream>
 #include "gdsio.h"
@@ -28,8 +30,56 @@
 namespace GDS
 {
 
-Boundary::Boundary() :Element(BOUNDARY)
+/*
+ * Vertex order of a rectangle: Rect_form - 1 holds the index of the first
+ * corner, counterclockwise from the lower left, times 2, plus 1 when the
+ * points go clockwise.
+ */
+static void RectPoints(const Box &box, Byte form, Point pts[5])
+{
+	Point corners[4] = {
+		Point(box.x, box.y),
+		Point(box.x + box.w, box.y),
+		Point(box.x + box.w, box.y + box.h),
+		Point(box.x, box.y + box.h)
+	};
+	int first = (form - 1) >> 1;
+	int step = ((form - 1) & 1) ? 3 : 1;
+	for (int i = 0; i < 4; i++)
+		pts[i] = corners[(first + i * step) % 4];
+	pts[4] = pts[0];
+}
+
+/*
+ * The form of the rectangle the points describe, or 0 if they are not one.
+ */
+static Byte RectForm(const Point *pts, size_t count, Box &box)
+{
+	if (count != 5)
+		return 0;
+	int llx = std::min(pts[0].x, pts[2].x);
+	int lly = std::min(pts[0].y, pts[2].y);
+	box = Box(llx, lly, std::max(pts[0].x, pts[2].x) - llx, std::max(pts[0].y, pts[2].y) - lly);
+	for (Byte form = 1; form <= 8; form++)
+	{
+		Point expected[5];
+		RectPoints(box, form, expected);
+		bool same = true;
+		for (int i = 0; i < 5 && same; i++)
+			same = expected[i].x == pts[i].x && expected[i].y == pts[i].y;
+		if (same)
+			return form;
+	}
+	return 0;
+}
+
+Boundary::Boundary() :Boundary(std::pmr::get_default_resource())
+{
+}
+
+Boundary::Boundary(std::pmr::memory_resource *resource) :Element(BOUNDARY), Pts(resource)
 {
+	Rect_form = 0;
 	Eflags = 0;
 	Layer = -1;
 	Data_type = -1;
@@ -37,7 +87,30 @@ Boundary::Boundary() :Element(BOUNDARY)
 
 Boundary::~Boundary()
 {
+	if (Rect_form == 0)
+		Pts.~PointArray();
+}
 
+void Boundary::makeRect(const Box &box, Byte form)
+{
+	if (Rect_form == 0)
+	{
+		std::pmr::memory_resource *resource = Pts.get_allocator().resource();
+		Pts.~PointArray();
+		new (&Rect) RectData{ box, resource };
+	}
+	else
+		Rect.box = box;
+	Rect_form = form;
+}
+
+void Boundary::makePolygon()
+{
+	if (Rect_form == 0)
+		return;
+	std::pmr::memory_resource *resource = Rect.resource;
+	new (&Pts) PointArray(resource);
+	Rect_form = 0;
 }
 
 short Boundary::layer() const
@@ -52,7 +125,30 @@ short Boundary::data_type() const
 
 std::vector<Point> Boundary::xy() const
 {
-	return Pts;
+	PointView pts = points();
+	return std::vector<Point>(pts.begin(), pts.end());
+}
+
+PointView Boundary::points() const
+{
+	if (Rect_form != 0)
+	{
+		Point pts[5];
+		RectPoints(Rect.box, Rect_form, pts);
+		return PointView(pts);
+	}
+	return PointView(Pts.data(), Pts.size());
+}
+
+bool Boundary::is_rect() const
+{
+	return Rect_form != 0;
+}
+
+const Box &Boundary::rect() const
+{
+	static const Box empty;
+	return Rect_form != 0 ? Rect.box : empty;
 }
 
 void Boundary::set_layer(short layer)
@@ -65,14 +161,57 @@ void Boundary::set_data_type(short data_type)
 	Data_type = data_type;
 }
 
+void Boundary::setPoints(const Point *pts, size_t count)
+{
+	Box box;
+	Byte form = RectForm(pts, count, box);
+	if (form != 0)
+		makeRect(box, form);
+	else
+	{
+		makePolygon();
+		Pts.assign(pts, pts + count);
+	}
+}
+
 void Boundary::set_xy(const std::vector<Point> &pts)
 {
-	Pts.clear();
-	Pts = pts;
+	setPoints(pts.data(), pts.size());
+}
+
+void Boundary::set_xy(PointArray &&pts)
+{
+	Box box;
+	Byte form = RectForm(pts.data(), pts.size(), box);
+	if (form != 0)
+		makeRect(box, form);
+	else
+	{
+		makePolygon();
+		Pts = std::move(pts);
+	}
+}
+
+void Boundary::set_xy(std::initializer_list<Point> pts)
+{
+	setPoints(pts.begin(), pts.size());
+}
+
+void Boundary::set_rect(const Box &rect)
+{
+	makeRect(rect, 1);
 }
 
 bool Boundary::bbox(int &x, int &y, int &w, int &h) const
 {
+	if (Rect_form != 0)
+	{
+		x = Rect.box.x;
+		y = Rect.box.y;
+		w = Rect.box.w;
+		h = Rect.box.h;
+		return true;
+	}
 	int llx = GDS_MAX_INT;
 	int lly = GDS_MAX_INT;
 	int urx = GDS_MIN_INT;
@@ -92,7 +231,7 @@ bool Boundary::bbox(int &x, int &y, int &w, int &h) const
 	return true;
 }
 
-int Boundary::read(std::ifstream &in, std::string &msg)
+int Boundary::read(Reader &in, std::string &msg)
 {
 	msg = "";
 	bool finished = false;
@@ -159,17 +298,26 @@ int Boundary::read(std::ifstream &in, std::string &msg)
 				ss << "wrong record size of XY for BOUNDARY (";
 				ss << std::hex << record_size << record_type << record_dt;
 				ss << "). ";
-				std::string msg = ss.str();
+				msg = ss.str();
 				return FORMAT_ERROR;
 			}
-			for (int i = 0; i < num; i++)
+			if (num == 5 && Rect_form == 0 && Pts.empty())
 			{
-				int x, y;
-				if (!readInteger(in, x)
-					|| !readInteger(in, y))
+				Point pts[5];
+				if (!readPoints(in, num, pts))
 					return FILE_ERROR;
-				Pts.push_back(Point(x, y));
+				setPoints(pts, 5);
+				break;
+			}
+			if (Rect_form != 0)
+			{
+				Point corners[5];
+				RectPoints(Rect.box, Rect_form, corners);
+				makePolygon();
+				Pts.assign(corners, corners + 5);
 			}
+			if (!readPoints(in, num, Pts))
+				return FILE_ERROR;
 			break;
 		}
 		default:
@@ -180,7 +328,7 @@ int Boundary::read(std::ifstream &in, std::string &msg)
 	return 0;
 }
 
-int Boundary::write(std::ofstream &out, std::string &msg)
+int Boundary::write(Writer &out, std::string &msg)
 {
 	short record_size;
 
@@ -207,15 +355,12 @@ int Boundary::write(std::ofstream &out, std::string &msg)
 	writeByte(out, Integer_2);
 	writeShort(out, Data_type);
 
-    record_size = 4 + short(8 * Pts.size());
+	PointView pts = points();
+    record_size = 4 + short(8 * pts.size());
 	writeShort(out, record_size);
 	writeByte(out, XY);
 	writeByte(out, Integer_4);
-	for (auto p : Pts)
-	{
-		writeInteger(out, p.x);
-		writeInteger(out, p.y);
-	}
+	writePoints(out, pts.data(), pts.size());
 
 	record_size = 4;
 	writeShort(out, record_size);
@@ -36,28 +36,70 @@ namespace GDS {
 	*  DATATYPE
 	*  XY
 	*  ENDEL
+	*
+	* An axis-aligned rectangle is kept as a Box instead of five points,
+	* together with the corner it starts from and its winding, so that it is
+	* written back with the points in their original order. The box shares
+	* its storage with the points.
 	*/
 class Boundary : public Element {
+	// A rectangle, and where to allocate the points if it stops being one.
+	struct RectData {
+		Box                         box;
+		std::pmr::memory_resource  *resource;
+	};
+
+	Byte                Rect_form;      //< 0 for a polygon in Pts, else the vertex order of Rect.
 	short               Eflags;         //< 2 bytes of bit flags. Not support yet.
 	short               Layer;
 	short               Data_type;
-	std::vector<Point>  Pts;
+	union {
+		PointArray      Pts;            //< While Rect_form is 0.
+		RectData        Rect;           //< Otherwise.
+	};
+
+	void setPoints(const Point *pts, size_t count);
+	void makeRect(const Box &box, Byte form);
+	void makePolygon();
 
 public:
 	Boundary();
+	/*!
+		* Construct with the points allocated from the given memory resource.
+		*/
+	explicit Boundary(std::pmr::memory_resource *resource);
 	virtual ~Boundary();
 
 	short layer() const;
     short data_type() const;
 	std::vector<Point> xy() const;
+	/*!
+		* The points without copying them, see PointView.
+		*/
+	PointView points() const;
+	/*!
+		* Whether the boundary is an axis-aligned rectangle, stored as rect().
+		*/
+	bool is_rect() const;
+	/*!
+		* The rectangle; an empty box if the boundary is not one.
+		*/
+	const Box &rect() const;
 	virtual bool bbox(int &x, int &y, int &w, int &h) const;
 
     void set_layer(short layer);
     void set_data_type(short data_type);
     void set_xy(const std::vector<Point> &pts);
+	/*!
+		* Take over the points. Their storage is kept when it comes from the
+		* same memory resource as the boundary, see Structure::set_arena().
+		*/
+	void set_xy(PointArray &&pts);
+	void set_xy(std::initializer_list<Point> pts);
+    void set_rect(const Box &rect);
 
-	virtual int read(std::ifstream &in, std::string &msg);
-	virtual int write(std::ofstream &out, std::string &msg);
+	virtual int read(Reader &in, std::string &msg);
+	virtual int write(Writer &out, std::string &msg);
 };
 
 }
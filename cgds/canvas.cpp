@@ -1,7 +1,9 @@
 #include <assert.h>
+#include <QtCore/QMetaObject>
 #include "canvas.h"
 #include "structures.h"
 #include "graphicsitems.h"
+#include "renderer.h"
 
 namespace GDS
 {
@@ -12,10 +14,16 @@ Canvas::Canvas(std::shared_ptr<Structure> cell, QWidget *parent)
     cell_ = cell;
     setScene(new QGraphicsScene());
     scale(1, -1);
-    for (size_t i = 0; i < cell_->size(); i++)
+    renderer_.reset(new TileRenderer(cell_));
+    item_ = new CellItem(cell_);
+    item_->set_renderer(renderer_.get());
+    scene()->addItem(item_);
+    // Tiles are finished on worker threads; repaint from the GUI thread.
+    QWidget *port = viewport();
+    renderer_->set_ready([port]()
     {
-        scene()->addItem(new ViewItem(cell_->get(i)));
-    }
+        QMetaObject::invokeMethod(port, [port]() { port->update(); }, Qt::QueuedConnection);
+    });
 //    scene()->addItem(new QGraphicsLineItem(0, -5, 0, 5));
 //    scene()->addItem(new QGraphicsLineItem(-5, 0, 5, 0));
     fitInView(scene()->sceneRect(), Qt::KeepAspectRatio);
@@ -23,7 +31,8 @@ Canvas::Canvas(std::shared_ptr<Structure> cell, QWidget *parent)
 
 Canvas::~Canvas()
 {
-
+    // The scene may outlive the view, but not the renderer.
+    item_->set_renderer(nullptr);
 }
 
 
@@ -5,6 +5,8 @@
 namespace GDS
 {
 class Structure;
+class TileRenderer;
+class CellItem;
 
 class Canvas : public QGraphicsView
 {
@@ -12,8 +14,14 @@ public:
     Canvas(std::shared_ptr<Structure> cell, QWidget *parent = 0);
     virtual ~Canvas();
 
+    TileRenderer &renderer() { return *renderer_; }
+    CellItem *item() { return item_; }
+
 private:
     std::shared_ptr<Structure> cell_;
+    std::unique_ptr<TileRenderer> renderer_;
+    // The only item of the scene; it draws from the tiles of renderer_.
+    CellItem *item_;
 };
 }
 #endif
@@ -11,36 +11,50 @@ QT       += gui
 TARGET = cgds
 TEMPLATE = lib
 CONFIG += staticlib
-CONFIG += c++11
+CONFIG += c++17
 
 SOURCES += \
+    arena.cpp \
     aref.cpp \
     boundary.cpp \
     canvas.cpp \
     elements.cpp \
+    flatten.cpp \
     gdsio.cpp \
     graphicsitems.cpp \
     library.cpp \
+    names.cpp \
     path.cpp \
+    renderer.cpp \
+    rtree.cpp \
+    snapshot.cpp \
     sref.cpp \
     structures.cpp \
     techfile.cpp \
-    text.cpp
+    text.cpp \
+    transform.cpp
 
 HEADERS += \
+    arena.h \
     aref.h \
     boundary.h \
     canvas.h \
     elements.h \
+    flatten.h \
     gdsio.h \
     graphicsitems.h \
     library.h \
+    names.h \
     path.h \
+    renderer.h \
+    rtree.h \
+    shapes.h \
     sref.h \
     structures.h \
     tags.h \
     techfile.h \
-    text.h
+    text.h \
+    transform.h
 unix {
     target.path = /usr/lib
     INSTALLS += target
@@ -27,7 +27,17 @@
 #include <fstream>
 
 namespace GDS {
-
+class Reader;
+class Writer;
+
+/*!
+	* \brief Base class of the GDSII elements.
+	*
+	* The setters of the elements do not notify the structure holding them:
+	* after changing an element of a structure in place, call
+	* Structure::Invalidate() on it, so that its bounds, index and cached
+	* drawings are brought up to date.
+	*/
 class Element {
 	Record_type Tag;
 
@@ -40,8 +50,8 @@ public:
 	std::string type() const;
     virtual bool bbox(int &x, int &y, int &w, int &h) const = 0;
 
-	virtual int read(std::ifstream &in, std::string &msg) = 0;
-	virtual int write(std::ofstream &out, std::string &msg) = 0;
+	virtual int read(Reader &in, std::string &msg) = 0;
+	virtual int write(Writer &out, std::string &msg) = 0;
 
 protected:
     void set_tag(Record_type tag);
@@ -0,0 +1,391 @@
+/*
+ * This file is part of GDSII.
+ *
+ * flatten.cpp -- The file which implements the flattening of a
+ *                structure hierarchy.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include "flatten.h"
+#include "structures.h"
+#include "sref.h"
+#include "aref.h"
+
+namespace GDS
+{
+
+// Points gathered by a thread for one layer before they go to the sink.
+static const size_t kBatchPoints = 1 << 16;
+// Placements of an AREF flattened by one task; larger arrays are split.
+static const int kArrayGrain = 1024;
+
+static int LayerId(short layer, short datatype)
+{
+	return int((unsigned short)layer) << 16 | (unsigned short)datatype;
+}
+
+/*
+ * An instance of a structure to flatten. For an AREF, the placements
+ * [first, last) of the array, numbered row by row.
+ */
+struct FlattenTask
+{
+	Structure   *cell;
+	Transform   transform;
+	ARef        *aref;
+	int         first, last;
+};
+
+class FlattenJob
+{
+	struct Queue
+	{
+		std::mutex               mutex;
+		std::deque<FlattenTask>  tasks;
+	};
+
+	const ShapeSink                             &Sink;
+	std::unordered_set<int>                     Layers;
+	// Whether a structure has shapes to keep, itself or below.
+	std::unordered_map<const Structure *, bool> Relevant;
+	std::vector<std::unique_ptr<Queue> >        Queues;
+	// Tasks queued or running; the work is done when it drops to 0.
+	std::atomic<size_t>                         Pending;
+	// Tasks queued, and the threads waiting for one in Idle.
+	std::atomic<size_t>                         Queued;
+	std::atomic<unsigned int>                   Sleeping;
+	std::mutex                                  Idle_mutex;
+	std::condition_variable                     Idle;
+
+	bool accept(short layer, short datatype) const
+	{
+		return Layers.empty() || Layers.count(LayerId(layer, datatype)) > 0;
+	}
+
+	bool relevant(Structure *cell)
+	{
+		auto iter = Relevant.find(cell);
+		if (iter != Relevant.end())
+			return iter->second;
+		// Set first so that a cyclic reference ends here. Every reachable
+		// structure is visited, so the threads only read the map.
+		Relevant[cell] = false;
+		bool found = false;
+		for (auto &shapes : *cell->layers())
+			found = found || accept(shapes.layer, shapes.datatype);
+		for (auto &node : cell->elements())
+		{
+			switch (node->tag())
+			{
+			case SREF:
+			{
+				auto ref = static_cast<SRef *>(node.get())->reference();
+				if (ref && relevant(ref.get()))
+					found = true;
+				break;
+			}
+			case AREF:
+			{
+				auto ref = static_cast<ARef *>(node.get())->reference();
+				if (ref && relevant(ref.get()))
+					found = true;
+				break;
+			}
+			default:
+				break;
+			}
+		}
+		Relevant[cell] = found;
+		return found;
+	}
+
+	bool visit(const Structure *cell) const
+	{
+		auto iter = Relevant.find(cell);
+		return iter != Relevant.end() && iter->second;
+	}
+
+	void push(unsigned int self, FlattenTask &&task)
+	{
+		Pending.fetch_add(1, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(Queues[self]->mutex);
+			Queues[self]->tasks.push_back(std::move(task));
+		}
+		// Either a sleeping thread is seen here, or it sees the task
+		// before it waits.
+		Queued.fetch_add(1);
+		if (Sleeping.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(Idle_mutex);
+			Idle.notify_one();
+		}
+	}
+
+	// Wait until a task is queued or the work is done.
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(Idle_mutex);
+		Sleeping.fetch_add(1);
+		Idle.wait(lock, [this]() { return Queued.load() > 0 || Pending.load() == 0; });
+		Sleeping.fetch_sub(1);
+	}
+
+	void done()
+	{
+		if (Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			std::lock_guard<std::mutex> lock(Idle_mutex);
+			Idle.notify_all();
+		}
+	}
+
+	// Own tasks are taken depth first from the back, stolen ones from the
+	// front, where the largest subtrees are.
+	bool pop(unsigned int self, FlattenTask &task)
+	{
+		Queue &queue = *Queues[self];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty())
+			return false;
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+		Queued.fetch_sub(1);
+		return true;
+	}
+
+	bool steal(unsigned int self, FlattenTask &task)
+	{
+		for (size_t i = 1; i < Queues.size(); i++)
+		{
+			Queue &queue = *Queues[(self + i) % Queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.tasks.empty())
+				continue;
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			Queued.fetch_sub(1);
+			return true;
+		}
+		return false;
+	}
+
+	void flush(std::unordered_map<int, ShapeArray> &buffers)
+	{
+		for (auto &item : buffers)
+		{
+			if (item.second.size() > 0)
+			{
+				Sink(item.second);
+				item.second.clear();
+			}
+		}
+	}
+
+	ShapeArray &buffer(std::unordered_map<int, ShapeArray> &buffers, short layer, short datatype)
+	{
+		auto iter = buffers.find(LayerId(layer, datatype));
+		if (iter == buffers.end())
+			iter = buffers.emplace(LayerId(layer, datatype), ShapeArray(layer, datatype)).first;
+		return iter->second;
+	}
+
+	void emit(std::unordered_map<int, ShapeArray> &buffers, const ShapeArray &shapes,
+			  const Transform &transform)
+	{
+		ShapeArray &out = buffer(buffers, shapes.layer, shapes.datatype);
+		size_t base = out.points.size();
+		out.points.resize(base + shapes.points.size());
+		transform.map(shapes.points.data(), out.points.data() + base, shapes.points.size());
+		for (size_t i = 1; i < shapes.offsets.size(); i++)
+			out.offsets.push_back(base + shapes.offsets[i]);
+		// A negative path width is absolute and does not scale.
+		double scale = transform.scale();
+		for (size_t i = 0; i < shapes.size(); i++)
+		{
+			int width = shapes.widths[i];
+			out.widths.push_back(width > 0 ? int(std::lround(width * scale)) : width);
+		}
+		out.tags.insert(out.tags.end(), shapes.tags.begin(), shapes.tags.end());
+		if (out.points.size() >= kBatchPoints)
+		{
+			Sink(out);
+			out.clear();
+		}
+	}
+
+	// Emit the shapes of one instance of a structure and queue its own
+	// references.
+	void expand(unsigned int self, Structure *cell, const Transform &transform,
+				std::unordered_map<int, ShapeArray> &buffers)
+	{
+		for (auto &shapes : *cell->layers())
+		{
+			if (accept(shapes.layer, shapes.datatype))
+				emit(buffers, shapes, transform);
+		}
+		for (auto &node : cell->elements())
+		{
+			switch (node->tag())
+			{
+			case SREF:
+			{
+				auto sref = static_cast<SRef *>(node.get());
+				auto ref = sref->reference();
+				if (!ref || !visit(ref.get()))
+					break;
+				Transform placement(sref->xy(), sref->mag(), sref->angle(),
+									sref->stransFlag(REFLECTION));
+				push(self, { ref.get(), transform * placement, nullptr, 0, 0 });
+				break;
+			}
+			case AREF:
+			{
+				auto aref = static_cast<ARef *>(node.get());
+				auto ref = aref->reference();
+				if (!ref || !visit(ref.get()) || aref->points().size() != 3
+					|| aref->row() <= 0 || aref->col() <= 0)
+					break;
+				push(self, { ref.get(), transform, aref, 0, aref->row() * aref->col() });
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	}
+
+	void process(unsigned int self, FlattenTask &task, std::unordered_map<int, ShapeArray> &buffers)
+	{
+		if (!task.aref)
+		{
+			expand(self, task.cell, task.transform, buffers);
+			return;
+		}
+		// Hand over half of the placements until a grain is left, and
+		// flatten the grain here.
+		while (task.last - task.first > kArrayGrain)
+		{
+			int middle = task.first + (task.last - task.first) / 2;
+			push(self, { task.cell, task.transform, task.aref, middle, task.last });
+			task.last = middle;
+		}
+		ARef *aref = task.aref;
+		PointView pts = aref->points();
+		for (int i = task.first; i < task.last; i++)
+		{
+			int row = i / aref->col();
+			int col = i % aref->col();
+			int dx = row * ((pts[2].x - pts[0].x) / aref->row())
+				+ col * ((pts[1].x - pts[0].x) / aref->col());
+			int dy = row * ((pts[2].y - pts[0].y) / aref->row())
+				+ col * ((pts[1].y - pts[0].y) / aref->col());
+			Transform placement(Point(pts[0].x + dx, pts[0].y + dy), aref->mag(),
+								aref->angle(), aref->stransFlag(REFLECTION));
+			expand(self, task.cell, task.transform * placement, buffers);
+		}
+	}
+
+	void run(unsigned int self)
+	{
+		std::unordered_map<int, ShapeArray> buffers;
+		FlattenTask task;
+		while (true)
+		{
+			if (pop(self, task) || steal(self, task))
+			{
+				process(self, task, buffers);
+				done();
+			}
+			else if (Pending.load(std::memory_order_acquire) == 0)
+				break;
+			else
+				wait();
+		}
+		flush(buffers);
+	}
+
+public:
+	FlattenJob(const std::set<LayerKey> &layers, const ShapeSink &sink)
+		: Sink(sink), Pending(0), Queued(0), Sleeping(0)
+	{
+		for (auto &key : layers)
+			Layers.insert(LayerId(key.first, key.second));
+	}
+
+	void start(Structure *top, unsigned int threads)
+	{
+		if (!relevant(top))
+			return;
+		for (unsigned int i = 0; i < threads; i++)
+			Queues.emplace_back(new Queue);
+		push(0, { top, Transform(), nullptr, 0, 0 });
+
+		std::vector<std::thread> pool;
+		for (unsigned int i = 1; i < threads; i++)
+			pool.emplace_back(&FlattenJob::run, this, i);
+		run(0);
+		for (auto &t : pool)
+			t.join();
+	}
+};
+
+void Flatten(std::shared_ptr<Structure> top, const std::set<LayerKey> &layers,
+			 const ShapeSink &sink, unsigned int threads)
+{
+	if (!top)
+		return;
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+	FlattenJob job(layers, sink);
+	job.start(top.get(), threads);
+}
+
+void Flatten(std::shared_ptr<Structure> top, const std::set<LayerKey> &layers,
+			 std::map<LayerKey, ShapeArray> &shapes, unsigned int threads)
+{
+	std::mutex mutex;
+	Flatten(top, layers, [&](ShapeArray &batch) {
+		std::lock_guard<std::mutex> lock(mutex);
+		LayerKey key(batch.layer, batch.datatype);
+		auto iter = shapes.find(key);
+		if (iter == shapes.end())
+		{
+			shapes.emplace(key, std::move(batch));
+			return;
+		}
+		ShapeArray &out = iter->second;
+		size_t base = out.points.size();
+		out.points.insert(out.points.end(), batch.points.begin(), batch.points.end());
+		for (size_t i = 1; i < batch.offsets.size(); i++)
+			out.offsets.push_back(base + batch.offsets[i]);
+		out.widths.insert(out.widths.end(), batch.widths.begin(), batch.widths.end());
+		out.tags.insert(out.tags.end(), batch.tags.begin(), batch.tags.end());
+	}, threads);
+}
+
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of GDSII.
+ *
+ * flatten.h -- The header file which declare the flattening of a
+ *              structure hierarchy.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef FLATTEN_H
+#define FLATTEN_H
+#include <map>
+#include <set>
+#include <memory>
+#include <functional>
+#include "shapes.h"
+
+namespace GDS {
+class Structure;
+
+typedef std::pair<short, short> LayerKey;
+
+/*!
+	* Receives the flattened shapes of one layer. It is called concurrently
+	* by the flattening threads and may move the content out of the array.
+	*/
+typedef std::function<void(ShapeArray &shapes)> ShapeSink;
+
+/*!
+	* Flatten the boundaries and paths under a structure into the coordinates
+	* of that structure.
+	*
+	* Each thread walks subtrees of the hierarchy from its own queue and
+	* steals from the others when it runs out of work; AREFs are split into
+	* ranges of placements. The shapes are gathered in per-thread buffers and
+	* handed to the sink in batches. Structures without any shape on the
+	* requested layers are skipped.
+	*
+	* \param [in] top		The structure to flatten.
+	* \param [in] layers	The (layer, datatype) pairs to keep. All when empty.
+	* \param [in] sink		Receives the batches of shapes.
+	* \param [in] threads	Number of threads. If it is 0, the number of
+	*						hardware threads is used.
+	*/
+void Flatten(std::shared_ptr<Structure> top, const std::set<LayerKey> &layers,
+			 const ShapeSink &sink, unsigned int threads = 1);
+/*!
+	* Flatten into one array per (layer, datatype). The order of the shapes
+	* depends on the scheduling of the threads.
+	*/
+void Flatten(std::shared_ptr<Structure> top, const std::set<LayerKey> &layers,
+			 std::map<LayerKey, ShapeArray> &shapes, unsigned int threads = 1);
+
+}
+
+#endif // FLATTEN_H
@@ -21,16 +21,279 @@
  **/
 
 #include <sstream>
-#include <cmath>
+#include <cstring>
+#include <cstdint>
 #include "gdsio.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GDS_X86_DISPATCH
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
-bool GDS::readShort(std::ifstream &in, short &data)
+// GDSII integers are big-endian, so they only need swapping on other hosts.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define GDS_BIG_ENDIAN_HOST
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace GDS
+{
+
+/*
+ * Read-only memory mapping of a whole file. Shared between readers so that
+ * sub-ranges of one file can be decoded independently.
+ **/
+class MappedFile {
+	const Byte *Data;
+	size_t      Size;
+#ifdef _WIN32
+	HANDLE      File;
+	HANDLE      Mapping;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const std::string &file_name);
+	const Byte *data() const { return Data; }
+	size_t size() const { return Size; }
+};
+
+MappedFile::MappedFile()
+{
+	Data = nullptr;
+	Size = 0;
+#ifdef _WIN32
+	File = INVALID_HANDLE_VALUE;
+	Mapping = NULL;
+#endif
+}
+
+#ifdef _WIN32
+
+MappedFile::~MappedFile()
+{
+	if (Data != nullptr)
+		UnmapViewOfFile(Data);
+	if (Mapping != NULL)
+		CloseHandle(Mapping);
+	if (File != INVALID_HANDLE_VALUE)
+		CloseHandle(File);
+}
+
+bool MappedFile::open(const std::string &file_name)
+{
+	File = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (File == INVALID_HANDLE_VALUE || GetFileType(File) != FILE_TYPE_DISK)
+		return false;
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(File, &file_size))
+		return false;
+	Size = size_t(file_size.QuadPart);
+	if (Size == 0)
+		return true;
+	Mapping = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (Mapping == NULL)
+		return false;
+	Data = (const Byte *)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	return Data != nullptr;
+}
+
+#else
+
+MappedFile::~MappedFile()
+{
+	if (Data != nullptr)
+		munmap((void *)Data, Size);
+}
+
+bool MappedFile::open(const std::string &file_name)
+{
+	int fd = ::open(file_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		close(fd);
+		return false;
+	}
+	Size = size_t(st.st_size);
+	if (Size == 0)
+	{
+		close(fd);
+		return true;
+	}
+	void *addr = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		return false;
+	madvise(addr, Size, MADV_SEQUENTIAL);
+	Data = (const Byte *)addr;
+	return true;
+}
+
+#endif
+
+Reader::Reader()
+{
+	Cur = nullptr;
+	End = nullptr;
+	In = nullptr;
+	Names = nullptr;
+}
+
+Reader::Reader(std::istream &in)
+{
+	Cur = nullptr;
+	End = nullptr;
+	In = &in;
+	Names = nullptr;
+}
+
+Reader::~Reader()
+{
+
+}
+
+bool Reader::open(const std::string &file_name)
+{
+	std::shared_ptr<MappedFile> map = std::make_shared<MappedFile>();
+	if (!map->open(file_name))
+		return false;
+	Map = map;
+	Cur = Map->data();
+	End = Cur + Map->size();
+	In = nullptr;
+	return true;
+}
+
+bool Reader::mapped() const
+{
+	return Map.get() != nullptr && In == nullptr;
+}
+
+size_t Reader::tell() const
+{
+	if (!mapped())
+		return 0;
+	return size_t(Cur - Map->data());
+}
+
+Reader Reader::range(size_t begin, size_t end) const
 {
+	Reader ret;
+	if (!mapped())
+		return ret;
+	end = end < Map->size() ? end : Map->size();
+	begin = begin < end ? begin : end;
+	ret.Map = Map;
+	ret.Cur = Map->data() + begin;
+	ret.End = Map->data() + end;
+	return ret;
+}
+
+// Bytes buffered before a Writer hands them to its stream.
+static const size_t kWriterChunk = 1 << 20;
 
-    Byte buffer[2];
-    in.read((char*)buffer, 2);
-	if (in.fail())
+Writer::Writer()
+{
+	Out = nullptr;
+	Size = 0;
+	Capacity = 0;
+	Failed = false;
+}
+
+Writer::Writer(std::ostream &out)
+{
+	Out = &out;
+	Size = 0;
+	Capacity = 0;
+	Failed = false;
+}
+
+Writer::~Writer()
+{
+	flush();
+}
+
+void Writer::grow(size_t size)
+{
+	if (Out != nullptr && Size > 0)
+	{
+		flush();
+		if (Capacity - Size >= size)
+			return;
+	}
+	size_t capacity = Capacity > 0 ? Capacity : kWriterChunk;
+	while (capacity - Size < size)
+		capacity *= 2;
+	std::unique_ptr<Byte[]> data(new Byte[capacity]);
+	if (Size > 0)
+		memcpy(data.get(), Data.get(), Size);
+	Data = std::move(data);
+	Capacity = capacity;
+}
+
+void Writer::write(const Byte *data, size_t size)
+{
+	if (Out != nullptr && size >= kWriterChunk)
+	{
+		flush();
+		Out->write((const char *)data, size);
+		if (Out->fail())
+			Failed = true;
+		return;
+	}
+	if (size > 0)
+		memcpy(append(size), data, size);
+}
+
+bool Writer::flush()
+{
+	if (Out == nullptr || Size == 0)
+		return !Failed;
+	Out->write((const char *)Data.get(), Size);
+	Size = 0;
+	if (Out->fail())
+		Failed = true;
+	return !Failed;
+}
+
+bool Writer::fail() const
+{
+	return Failed;
+}
+
+const Byte *Reader::fetchStream(size_t size)
+{
+	if (Buffer.size() < size)
+		Buffer.resize(size);
+	In->read((char*)Buffer.data(), size);
+	if (In->fail())
+		return nullptr;
+	return Buffer.data();
+}
+
+}
+
+
+bool GDS::readShort(Reader &in, short &data)
+{
+    const Byte *buffer = in.fetch(2);
+	if (buffer == nullptr)
 		return false;
 	
 	data = buffer[0] << 8 | buffer[1];
@@ -38,22 +301,19 @@ bool GDS::readShort(std::ifstream &in, short &data)
     return true;
 }
 
-bool GDS::writeShort(std::ofstream &out, short data)
+bool GDS::writeShort(Writer &out, short data)
 {
-    char high, low;
-    high = (data & 0xff00) >> 8;
-    low = data & 0x00ff;
-    out.write(&high, 1);
-    out.write(&low, 1);
+    Byte *buffer = out.append(2);
+    buffer[0] = (data & 0xff00) >> 8;
+    buffer[1] = data & 0x00ff;
 
-	return !out.fail();
+    return !out.fail();
 }
 
-bool GDS::readInteger(std::ifstream &in, int &data)
+bool GDS::readInteger(Reader &in, int &data)
 {
-    Byte buffer[4];
-    in.read((char*)buffer, 4);
-	if (in.fail())
+    const Byte *buffer = in.fetch(4);
+	if (buffer == nullptr)
 		return false;
 
     data = buffer[3]
@@ -64,148 +324,331 @@ bool GDS::readInteger(std::ifstream &in, int &data)
     return true;
  }
 
-bool GDS::writeInteger(std::ofstream &out, int data)
+static void swapBytes32Scalar(const GDS::Byte *src, GDS::Byte *dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t word;
+        memcpy(&word, src + 4 * i, 4);
+        word = (word >> 24) | ((word >> 8) & 0xff00) | ((word << 8) & 0xff0000) | (word << 24);
+        memcpy(dst + 4 * i, &word, 4);
+    }
+}
+
+#if defined(GDS_X86_DISPATCH) || (defined(_MSC_VER) && defined(__AVX2__))
+
+#ifdef GDS_X86_DISPATCH
+__attribute__((target("avx2")))
+#endif
+static void swapBytes32AVX2(const GDS::Byte *src, GDS::Byte *dst, size_t count)
+{
+    const __m256i mask = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i words = _mm256_loadu_si256((const __m256i *)(src + 4 * i));
+        _mm256_storeu_si256((__m256i *)(dst + 4 * i), _mm256_shuffle_epi8(words, mask));
+    }
+    swapBytes32Scalar(src + 4 * i, dst + 4 * i, count - i);
+}
+
+#endif
+
+#ifdef GDS_X86_DISPATCH
+
+__attribute__((target("ssse3")))
+static void swapBytes32SSSE3(const GDS::Byte *src, GDS::Byte *dst, size_t count)
+{
+    const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i words = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+        _mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_shuffle_epi8(words, mask));
+    }
+    swapBytes32Scalar(src + 4 * i, dst + 4 * i, count - i);
+}
+
+typedef void (*SwapBytes32)(const GDS::Byte *, GDS::Byte *, size_t);
+
+static SwapBytes32 SelectSwapBytes32()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return swapBytes32AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+        return swapBytes32SSSE3;
+    return swapBytes32Scalar;
+}
+
+#endif
+
+void GDS::swapBytes32(const Byte *src, Byte *dst, size_t count)
+{
+#if defined(GDS_X86_DISPATCH)
+    static const SwapBytes32 swap = SelectSwapBytes32();
+    swap(src, dst, count);
+#elif defined(_MSC_VER) && defined(__AVX2__)
+    swapBytes32AVX2(src, dst, count);
+#else
+    swapBytes32Scalar(src, dst, count);
+#endif
+}
+
+/*
+ * Convert `count` 4-byte words between the big-endian order of GDSII and the
+ * order of the host.
+ **/
+static void bigEndian32(const GDS::Byte *src, GDS::Byte *dst, size_t count)
 {
-    Byte buffer[4];
+#ifdef GDS_BIG_ENDIAN_HOST
+    if (src != dst)
+        memcpy(dst, src, 4 * count);
+#else
+    GDS::swapBytes32(src, dst, count);
+#endif
+}
+
+bool GDS::readPoints(Reader &in, int count, PointArray &pts)
+{
+    if (count <= 0)
+        return count == 0;
+    const Byte *buffer = in.fetch(8 * size_t(count));
+    if (buffer == nullptr)
+        return false;
+    size_t begin = pts.size();
+    pts.resize(begin + count);
+    bigEndian32(buffer, (Byte *)(pts.data() + begin), 2 * size_t(count));
+    return true;
+}
+
+bool GDS::readPoints(Reader &in, int count, Point *pts)
+{
+    static_assert(sizeof(Point) == 8, "Point must be two packed 4-byte integers");
+    if (count <= 0)
+        return count == 0;
+    const Byte *buffer = in.fetch(8 * size_t(count));
+    if (buffer == nullptr)
+        return false;
+    bigEndian32(buffer, (Byte *)pts, 2 * size_t(count));
+    return true;
+}
+
+bool GDS::writeInteger(Writer &out, int data)
+{
+    Byte *buffer = out.append(4);
     buffer[3] = data & 0xff;
     buffer[2] = (data >> 8) & 0xff;
     buffer[1] = (data >> 16) & 0xff;
     buffer[0] = (data >> 24) & 0xff;
-    out.write((char *)buffer, 4);
 
-	return !out.fail();
+    return !out.fail();
 }
 
-bool GDS::readString(std::ifstream &in, int size, std::string &data)
+bool GDS::writePoints(Writer &out, const PointArray &pts)
+{
+    return writePoints(out, pts.data(), pts.size());
+}
+
+bool GDS::writePoints(Writer &out, const Point *pts, size_t count)
+{
+    Byte *buffer = out.append(8 * count);
+    bigEndian32((const Byte *)pts, buffer, 2 * count);
+
+    return !out.fail();
+}
+
+bool GDS::readString(Reader &in, int size, std::string &data)
 {
 	data = "";
+	if (size <= 0)
+		return size == 0;
+    const Byte *buffer = in.fetch(size);
+	if (buffer == nullptr)
+		return false;
+	data.reserve(size);
     for (int i = 0; i < size; i++)
     {
-        char c;
-        in.read(&c, 1);
-		if (in.fail())
-			return false;
-        if (c != '\0')
-            data.push_back(c);
+        if (buffer[i] != '\0')
+            data.push_back(char(buffer[i]));
     }
     return true;
 }
 
-bool GDS::writeString(std::ofstream &out, std::string data)
+static GDS::NameId internName(GDS::Reader &in, std::string_view name)
+{
+	if (in.names() == nullptr)
+		return GDS::NameTable::detached()->intern(name);
+	return in.names()->intern(name);
+}
+
+bool GDS::readName(Reader &in, int size, NameId &id)
 {
-    out.write(data.c_str(), data.size());
-    
+	id = 0;
+	if (size <= 0)
+		return size == 0;
+	const Byte *buffer = in.fetch(size);
+	if (buffer == nullptr)
+		return false;
+	// Strings are padded with NULs to an even size.
+	int length = size;
+	while (length > 0 && buffer[length - 1] == '\0')
+		length--;
+	if (memchr(buffer, '\0', length) == nullptr)
+	{
+		id = internName(in, std::string_view((const char *)buffer, length));
+		return true;
+	}
+	std::string data;
+	for (int i = 0; i < length; i++)
+	{
+		if (buffer[i] != '\0')
+			data.push_back(char(buffer[i]));
+	}
+	id = internName(in, data);
+	return true;
+}
+
+bool GDS::writeString(Writer &out, const std::string &data)
+{
+    size_t size = data.size() + data.size() % 2;
+    Byte *buffer = out.append(size);
+    memcpy(buffer, data.c_str(), data.size());
     if (data.size() % 2 != 0)
-    {
-        char c = '\0';
-        out.write(&c, 1);
-    }
+        buffer[size - 1] = '\0';
 
-	return !out.fail();
+    return !out.fail();
 }
 
-bool GDS::readBitarray(std::ifstream &in, short &data)
+bool GDS::readBitarray(Reader &in, short &data)
 {
     return readShort(in, data);
 }
 
-bool GDS::writeBitarray(std::ofstream &out, short data)
+bool GDS::writeBitarray(Writer &out, short data)
 {
     return writeShort(out, data);
 }
 
-bool GDS::readDouble(std::ifstream &in, double &data)
+/*
+ * A GDSII real is sign * mantissa * 16^(exponent - 64) * 2^-56, with a 7-bit
+ * excess-64 exponent and a 56-bit mantissa. Every such value is a normal
+ * IEEE-754 double, so decoding only rounds the mantissa to 53 bits, and every
+ * double in range is encoded exactly since 53 bits always fit in 56.
+ **/
+double GDS::decodeReal8(const Byte *data)
 {
-    unsigned char buffer[8];
-    in.read((char*)buffer, 8);
-	if (in.fail())
-		return false;
-
-    short sign_flag = (buffer[0] & 0x80) ? -1 : 1;
-    short exponent = (buffer[0] & 0x7f) - 64;
-    long long mantissa = 0;
+    uint64_t mantissa = 0;
     for (int i = 1; i < 8; i++)
+        mantissa = (mantissa << 8) | data[i];
+    // 2^(4 * (exponent - 64) - 56) lies in [2^-312, 2^196].
+    int64_t power = 4 * int64_t(data[0] & 0x7f) - 256 - 56;
+    uint64_t scale_bits = uint64_t(power + 1023) << 52;
+    double scale;
+    memcpy(&scale, &scale_bits, 8);
+    // The integer conversion rounds to nearest even; the scaling is exact.
+    double value = double(int64_t(mantissa)) * scale;
+    return (data[0] & 0x80) ? -value : value;
+}
+
+void GDS::encodeReal8(double value, Byte *data)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, 8);
+    Byte sign = (bits >> 56) & 0x80;
+    int64_t biased = int64_t((bits >> 52) & 0x7ff);
+    uint64_t mantissa = bits & ((uint64_t(1) << 52) - 1);
+
+    // Zeros, subnormals and NaN are far below the smallest GDSII real.
+    if (biased == 0 || (biased == 0x7ff && mantissa != 0))
     {
-        mantissa = mantissa << 8;
-        //mantissa = mantissa | (0x00000000000000ff & buffer[i]);
-        mantissa = mantissa | buffer[i];
+        memset(data, 0, 8);
+        return;
     }
+    mantissa |= uint64_t(1) << 52;
 
-    data = mantissa / std::pow(2.0, 56);
-    if (exponent >= 0)
+    // value = mantissa * 2^p; pick the hex exponent so that the 53-bit
+    // mantissa shifted left by p mod 4 is normalized in 56 bits.
+    int64_t p = biased - 1023 - 52 + 56;
+    int64_t exponent = (p >> 2) + 64;       // floor(p / 4) + 64
+    mantissa <<= (p & 3);
+
+    if (biased == 0x7ff || exponent > 127)
     {
-        for (int j = 0; j < exponent; j++)
-        {
-            data = data * 16;
-        }
+        // Saturate to the largest magnitude.
+        exponent = 127;
+        mantissa = (uint64_t(1) << 56) - 1;
     }
-    else
+    else if (exponent < 0)
     {
-        for (int j = 0; j < -exponent; j++)
+        // Denormalize, rounding to nearest even.
+        int64_t shift = -4 * exponent;
+        exponent = 0;
+        if (shift > 57)
+            mantissa = 0;
+        else
         {
-            data = data / 16;
+            uint64_t half = uint64_t(1) << (shift - 1);
+            uint64_t rest = mantissa & ((half << 1) - 1);
+            mantissa >>= shift;
+            if (rest > half || (rest == half && (mantissa & 1)))
+                mantissa++;
         }
     }
-    data = data * sign_flag;
 
-	return true;
+    data[0] = sign | Byte(exponent);
+    for (int i = 7; i > 0; i--)
+    {
+        data[i] = Byte(mantissa);
+        mantissa >>= 8;
+    }
 }
 
-bool GDS::writeDouble(std::ofstream &out, double data)
+void GDS::decodeReal8(const Byte *data, double *values, size_t count)
 {
-    unsigned char buffer[8];
-    if (data == 0)
-    {
-        for (int i = 0; i < 8; i++)
-        {
-            buffer[i] = 0;
-        }
-        out.write((char*)buffer, 8);
-    }
-    else
-    {
-        double mantissa = data >= 0 ? data : -data;
-        short exponent = 0;
-        while (mantissa >= 1 || mantissa < (1.0 / 16))
-        {
-            if (mantissa >= 1)
-            {
-                mantissa /= 16;
-                exponent ++;
-            }
-            else
-            {
-                mantissa *= 16;
-                exponent --;
-            }
-        }
-        exponent += 64;
-        buffer[0] = exponent;
-        if (data < 0)
-            buffer[0] = buffer[0] | 0x80;
-        for (int j = 1; j < 8; j++)
-        {
-            mantissa *= 256;
-            buffer[j] = mantissa;
-            mantissa = mantissa - int(mantissa);
+    for (size_t i = 0; i < count; i++)
+        values[i] = decodeReal8(data + 8 * i);
+}
 
-        }
-        out.write((char*)buffer, 8);
-    }
+void GDS::encodeReal8(const double *values, Byte *data, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        encodeReal8(values[i], data + 8 * i);
+}
 
-	return !out.fail();
+bool GDS::readDouble(Reader &in, double &data)
+{
+    const Byte *buffer = in.fetch(8);
+	if (buffer == nullptr)
+		return false;
+
+    data = decodeReal8(buffer);
+
+	return true;
 }
 
-bool GDS::readByte(std::ifstream &in, GDS::Byte &data)
+bool GDS::writeDouble(Writer &out, double data)
 {
-    in.read((char*)&data, 1);
-	return !in.fail();
+    encodeReal8(data, out.append(8));
+
+    return !out.fail();
+}
+
+bool GDS::readByte(Reader &in, GDS::Byte &data)
+{
+    const Byte *buffer = in.fetch(1);
+	if (buffer == nullptr)
+		return false;
+	data = buffer[0];
+	return true;
 }
 
-bool GDS::writeByte(std::ofstream &out, GDS::Byte data)
+bool GDS::writeByte(Writer &out, GDS::Byte data)
 {
-    out.write((char*)&data, 1);
-	return !out.fail();
+    *out.append(1) = data;
+    return !out.fail();
 }
 
 std::string GDS::byteToString(Byte data)
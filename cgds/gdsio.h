@@ -23,11 +23,140 @@
 #ifndef GDSIO_H
 #define GDSIO_H
 #include <fstream>
+#include <istream>
+#include <ostream>
+#include <memory>
 #include <string>
+#include <vector>
 #include "tags.h"
+#include "names.h"
 
 namespace GDS {
 
+class MappedFile;
+
+/*!
+	* \brief Input source of GDSII records.
+	*
+	* A reader either maps the whole file into memory and hands out pointers
+	* straight into the mapped bytes, or falls back to an std::istream (e.g.
+	* for pipes) which is read one field at a time.
+	*/
+class Reader {
+	std::shared_ptr<MappedFile>  Map;
+	const Byte                  *Cur;
+	const Byte                  *End;
+	std::istream                *In;
+	std::vector<Byte>            Buffer;
+	NameCache                   *Names;
+
+	const Byte *fetchStream(size_t size);
+
+public:
+	Reader();
+	Reader(std::istream &in);
+	~Reader();
+
+	/*!
+		* Map a file into memory. On failure the reader is left unchanged.
+		*
+		* \param [in] file_name		Path of the GDSII file.
+		*
+		* \return	true if the file has been mapped.
+		*/
+	bool open(const std::string &file_name);
+	bool mapped() const;
+	/*!
+		* Offset of the next byte in a mapped file. Always 0 for streams.
+		*/
+	size_t tell() const;
+	/*!
+		* A reader over bytes [begin, end) of the same mapped file, which
+		* can be consumed independently of (and concurrently with) this one.
+		*/
+	Reader range(size_t begin, size_t end) const;
+	/*!
+		* Where readName() interns the names, usually in front of the table
+		* of the library being read. Without one, the names go to
+		* NameTable::detached(). Readers made by range() have none.
+		*/
+	void set_names(NameCache *names) { Names = names; }
+	NameCache *names() const { return Names; }
+	/*!
+		* The table the indices returned by readName() belong to.
+		*/
+	const std::shared_ptr<NameTable> &name_table() const
+	{
+		return Names != nullptr ? Names->table() : NameTable::detached();
+	}
+
+	/*!
+		* Consume the next bytes of the input.
+		*
+		* \return	Pointer to `size` contiguous bytes, which stays valid until
+		*			the next call, or nullptr if the input is exhausted.
+		*/
+	const Byte *fetch(size_t size)
+	{
+		if (In != nullptr)
+			return fetchStream(size);
+		if (size_t(End - Cur) < size)
+			return nullptr;
+		const Byte *ret = Cur;
+		Cur += size;
+		return ret;
+	}
+};
+
+/*!
+	* \brief Output buffer of GDSII records.
+	*
+	* Records are serialized into a memory buffer which is handed to the
+	* std::ostream in large chunks. Without a stream the writer only
+	* accumulates the bytes, see data().
+	*/
+class Writer {
+	std::ostream                *Out;
+	std::unique_ptr<Byte[]>      Data;
+	size_t                       Size;
+	size_t                       Capacity;
+	bool                         Failed;
+
+	void grow(size_t size);
+
+public:
+	Writer();
+	Writer(std::ostream &out);
+	~Writer();
+
+	/*!
+		* Append `size` bytes to the output.
+		*
+		* \return	Pointer to the appended bytes, which must be filled before
+		*			the next call.
+		*/
+	Byte *append(size_t size)
+	{
+		if (Capacity - Size < size)
+			grow(size);
+		Byte *ret = Data.get() + Size;
+		Size += size;
+		return ret;
+	}
+	/*!
+		* Append a block of bytes. Large blocks bypass the buffer.
+		*/
+	void write(const Byte *data, size_t size);
+	/*!
+		* Hand the buffered bytes to the stream. Does nothing without a stream.
+		*/
+	bool flush();
+	bool fail() const;
+
+	const Byte *data() const { return Data.get(); }
+	size_t size() const { return Size; }
+};
+
 /*
  * 2-Byte Signed Integer    ---- short
  * 4-Byte Signed Integer    ---- int
@@ -37,20 +166,57 @@ namespace GDS {
  * Bit Array                ---- short
  **/
 
-bool readByte(std::ifstream &in, Byte &data);
-bool readShort(std::ifstream &in, short &data);
-bool readInteger(std::ifstream &in, int &data);
-bool readDouble(std::ifstream &in, double &data);
-bool readString(std::ifstream &in, int size, std::string &data);
-bool readBitarray(std::ifstream &in, short &data);
-
-bool writeByte(std::ofstream &out, Byte data);
-bool writeShort(std::ofstream &out, short data);
-bool writeInteger(std::ofstream &out, int data);
-bool writeFloat(std::ofstream &out, float data);
-bool writeDouble(std::ofstream &out, double data);
-bool writeString(std::ofstream &out, std::string data);
-bool writeBitarray(std::ofstream &out, short data);
+bool readByte(Reader &in, Byte &data);
+bool readShort(Reader &in, short &data);
+bool readInteger(Reader &in, int &data);
+bool readDouble(Reader &in, double &data);
+bool readString(Reader &in, int size, std::string &data);
+/*
+ * Read a string record payload and intern it in the names of the reader,
+ * see Reader::name_table(). Only a name not seen before is copied.
+ **/
+bool readName(Reader &in, int size, NameId &id);
+bool readBitarray(Reader &in, short &data);
+/*
+ * Read `count` points, i.e. the payload of an XY record, and append them to
+ * `pts` with a single allocation.
+ **/
+bool readPoints(Reader &in, int count, PointArray &pts);
+bool readPoints(Reader &in, int count, Point *pts);
+
+bool writeByte(Writer &out, Byte data);
+bool writeShort(Writer &out, short data);
+bool writeInteger(Writer &out, int data);
+bool writeFloat(Writer &out, float data);
+bool writeDouble(Writer &out, double data);
+bool writeString(Writer &out, const std::string &data);
+bool writeBitarray(Writer &out, short data);
+/*
+ * Write the points as big-endian pairs of 4-byte integers, i.e. the payload
+ * of an XY record, in one go.
+ **/
+bool writePoints(Writer &out, const PointArray &pts);
+bool writePoints(Writer &out, const Point *pts, size_t count);
+
+/*
+ * Reverse the byte order of `count` 4-byte words. Uses AVX2 or SSSE3 when
+ * the CPU supports them. `src` and `dst` may be the same but must not
+ * otherwise overlap. readPoints() and writePoints() only swap on
+ * little-endian hosts.
+ **/
+void swapBytes32(const Byte *src, Byte *dst, size_t count);
+
+/*
+ * Conversion between IEEE-754 doubles and 8-byte GDSII reals (excess-64,
+ * base 16). Decoding rounds to nearest even. Doubles too large for GDSII
+ * saturate to the largest real. Doubles below the smallest normalized real
+ * (16^-65) are denormalized with round-to-nearest-even, so only those under
+ * half the smallest denormal (2^-312) become zero, as do NaNs.
+ **/
+double decodeReal8(const Byte *data);
+void encodeReal8(double value, Byte *data);
+void decodeReal8(const Byte *data, double *values, size_t count);
+void encodeReal8(const double *values, Byte *data, size_t count);
 
 std::string byteToString(Byte data);
 
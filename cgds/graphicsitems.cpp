@@ -1,28 +1,61 @@
 #include <assert.h>
+#include <algorithm>
+#include <cmath>
 #include <vector>
+#include <unordered_map>
 #include <QtCore/QPoint>
 #include <QtGui/QPolygon>
 #include <QtGui/QPainter>
 #include <QtGui/QPainterPath>
+#include <QtGui/QImage>
+#include <QtWidgets/QStyleOptionGraphicsItem>
 #include "techfile.h"
 #include "structures.h"
 #include "boundary.h"
 #include "path.h"
 #include "aref.h"
 #include "sref.h"
+#include "transform.h"
 #include "graphicsitems.h"
+#include "renderer.h"
 
 namespace GDS
 {
-void PaintPolygon(QPainter &painter, std::shared_ptr<Element> data);
-void PaintPath(QPainter &painter, std::shared_ptr<Element> data);
-void PaintSRef(QPainter &painter, std::shared_ptr<Element> data, int level = -1);
-void PaintARef(QPainter &painter, std::shared_ptr<Element> data, int level = -1);
+/*
+ * The part of the device being painted and the level of detail, shared by
+ * the whole hierarchy drawn by one call.
+ */
+struct PaintContext
+{
+    // A cell rasterized for stamping the instances of arrays.
+    struct Stamp
+    {
+        const Structure *cell;
+        int level;
+        // The linear part of the transform from the cell to the device.
+        qreal m11, m12, m21, m22;
+        QImage image;
+        // Where the origin of the cell falls in the image.
+        QPointF origin;
+    };
+
+    RenderOptions options;
+    // The exposed area, in device coordinates.
+    QRectF device;
+    // Stamps made during this paint; arrays of the same cell share them.
+    mutable std::vector<Stamp> stamps;
+};
+
+void PaintPolygon(QPainter &painter, const std::shared_ptr<Element> &data);
+void PaintPath(QPainter &painter, const std::shared_ptr<Element> &data);
+void PaintSRef(QPainter &painter, const std::shared_ptr<Element> &data,
+               const PaintContext &context, int level = -1);
+void PaintARef(QPainter &painter, const std::shared_ptr<Element> &data,
+               const PaintContext &context, int level = -1);
 void PaintCell(QPainter &painter, std::shared_ptr<Structure> cell,
+               const PaintContext &context,
                int level = -1,
-               int offset_x = 0, int offset_y = 0,
-               double mag = 1.0, double angle = 0.0,
-               bool reflect = false);
+               const Transform &transform = Transform());
 void InitPainter(QPainter &painter, short layer, short purpose);
 
 
@@ -30,7 +63,7 @@ ViewItem::ViewItem(std::shared_ptr<Element> data, QGraphicsItem *parent)
     : QGraphicsItem(parent)
 {
     data_ = data;
-    setFlags(ItemIsSelectable);
+    setFlags(ItemIsSelectable | ItemUsesExtendedStyleOption);
 }
 
 QRectF ViewItem::boundingRect() const
@@ -46,6 +79,9 @@ QRectF ViewItem::boundingRect() const
 
 void ViewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
+    PaintContext context;
+    context.options = options_;
+    context.device = painter->transform().mapRect(option->exposedRect);
     switch(tag())
     {
     case BOUNDARY:
@@ -55,10 +91,10 @@ void ViewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
         PaintPath(*painter, data_.lock());
         break;
     case SREF:
-        PaintSRef(*painter, data_.lock());
+        PaintSRef(*painter, data_.lock(), context);
         break;
     case AREF:
-        PaintARef(*painter, data_.lock());
+        PaintARef(*painter, data_.lock(), context);
         break;
     default:
         break;
@@ -76,25 +112,186 @@ std::shared_ptr<Element> ViewItem::data()
     return data_.lock();
 }
 
-void PaintPolygon(QPainter &painter, std::shared_ptr<Element> data)
+CellItem::CellItem(std::shared_ptr<Structure> cell, QGraphicsItem *parent)
+    : QGraphicsItem(parent), cell_(cell), level_(-1), renderer_(nullptr)
+{
+    setFlags(ItemUsesExtendedStyleOption);
+}
+
+QRectF CellItem::boundingRect() const
+{
+    int x, y, w, h;
+    if (cell_ && cell_->bbox(x, y, w, h))
+        return QRectF(x, y, w, h);
+    return QRectF();
+}
+
+void CellItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    if (renderer_)
+        renderer_->draw(*painter, option->exposedRect);
+    else
+        PaintCell(*painter, cell_, painter->transform().mapRect(option->exposedRect), options_, level_);
+}
+
+std::shared_ptr<Element> CellItem::elementAt(const QPointF &pos) const
+{
+    if (!cell_)
+        return nullptr;
+    std::vector<int> indices;
+    Box point(int(std::floor(pos.x())), int(std::floor(pos.y())), 1, 1);
+    cell_->query(point, indices);
+    // Later elements are drawn on top.
+    if (indices.empty())
+        return nullptr;
+    return cell_->elements()[indices.back()];
+}
+
+/*
+ * The exposed area in the coordinates the painter currently maps from, and
+ * the number of pixels per unit there. False if nothing can be visible.
+ */
+static bool LocalWindow(const QPainter &painter, const PaintContext &context,
+                        Box &window, double &scale)
+{
+    const QTransform &world = painter.transform();
+    bool invertible = false;
+    QTransform inverse = world.inverted(&invertible);
+    if (!invertible || context.device.isEmpty())
+        return false;
+    QRectF local = inverse.mapRect(context.device);
+    double llx = std::max(std::floor(local.left()), double(GDS_MIN_INT / 2));
+    double lly = std::max(std::floor(local.top()), double(GDS_MIN_INT / 2));
+    double urx = std::min(std::ceil(local.right()), double(GDS_MAX_INT / 2));
+    double ury = std::min(std::ceil(local.bottom()), double(GDS_MAX_INT / 2));
+    if (urx < llx || ury < lly)
+        return false;
+    window = Box(int(llx), int(lly), int(urx - llx), int(ury - lly));
+    scale = std::sqrt(std::fabs(world.m11() * world.m22() - world.m12() * world.m21()));
+    return true;
+}
+
+/*
+ * Stand-in for an element too small to be drawn in detail.
+ */
+static void PaintSmall(QPainter &painter, const Element &node, const Box &box,
+                       const PaintContext &context)
+{
+    if (!context.options.draw_small)
+        return;
+    switch (node.tag())
+    {
+    case BOUNDARY:
+    {
+        auto &polygon = static_cast<const Boundary &>(node);
+        InitPainter(painter, polygon.layer(), polygon.data_type());
+        break;
+    }
+    case PATH:
+    {
+        auto &path = static_cast<const Path &>(node);
+        InitPainter(painter, path.layer(), path.data_type());
+        break;
+    }
+    case SREF:
+    case AREF:
+    {
+        QPen pen(context.options.small_cell_color);
+        pen.setCosmetic(true);
+        painter.setPen(pen);
+        painter.setBrush(QBrush(context.options.small_cell_color));
+        break;
+    }
+    default:
+        return;
+    }
+    painter.drawRect(QRect(box.x, box.y, box.w, box.h));
+}
+
+// Stamps kept by one paint; the oldest is dropped beyond it.
+static const size_t kMaxStamps = 16;
+
+/*
+ * The cell rasterized with the painter's current transform followed by the
+ * placement, without its translation, so that it can be stamped at every
+ * instance of an array. Made once per paint for each cell and orientation.
+ */
+static const PaintContext::Stamp *CellStamp(QPainter &painter, const std::shared_ptr<Structure> &cell,
+                                            const Transform &placement, int level,
+                                            const PaintContext &context)
+{
+    QTransform device = QTransform(placement.a(), placement.c(), placement.b(), placement.d(), 0, 0)
+        * painter.transform();
+    QTransform linear(device.m11(), device.m12(), device.m21(), device.m22(), 0, 0);
+    for (auto &stamp : context.stamps)
+    {
+        if (stamp.cell == cell.get() && stamp.level == level
+            && stamp.m11 == linear.m11() && stamp.m12 == linear.m12()
+            && stamp.m21 == linear.m21() && stamp.m22 == linear.m22())
+            return &stamp;
+    }
+
+    int x, y, w, h;
+    if (!cell->bbox(x, y, w, h))
+        return nullptr;
+    QRectF bounds = linear.mapRect(QRectF(x, y, w, h));
+    // A pixel of margin for the cosmetic pens on the edges.
+    int width = int(std::ceil(bounds.width())) + 2;
+    int height = int(std::ceil(bounds.height())) + 2;
+    if (width <= 0 || height <= 0)
+        return nullptr;
+    PaintContext::Stamp stamp;
+    stamp.cell = cell.get();
+    stamp.level = level;
+    stamp.m11 = linear.m11();
+    stamp.m12 = linear.m12();
+    stamp.m21 = linear.m21();
+    stamp.m22 = linear.m22();
+    stamp.origin = QPointF(1 - bounds.left(), 1 - bounds.top());
+    stamp.image = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+    stamp.image.fill(Qt::transparent);
+    QPainter image_painter(&stamp.image);
+    image_painter.setTransform(linear * QTransform(1, 0, 0, 1, stamp.origin.x(), stamp.origin.y()));
+    PaintContext image_context;
+    image_context.options = context.options;
+    image_context.device = QRectF(0, 0, width, height);
+    PaintCell(image_painter, cell, image_context, level);
+    image_painter.end();
+    // The pointer is only used until the next stamp is made.
+    if (context.stamps.size() >= kMaxStamps)
+        context.stamps.erase(context.stamps.begin());
+    context.stamps.push_back(stamp);
+    return &context.stamps.back();
+}
+
+void PaintPolygon(QPainter &painter, const std::shared_ptr<Element> &data)
 {
     auto polygon = std::dynamic_pointer_cast<Boundary>(data);
     if (!polygon)
         return;
     InitPainter(painter, polygon->layer(), polygon->data_type());
-    QPolygon tmp;
-    for (Point pt : polygon->xy())
-        tmp << QPoint(pt.x, pt.y);
+    if (polygon->is_rect())
+    {
+        const Box &rect = polygon->rect();
+        painter.drawRect(QRect(rect.x, rect.y, rect.w, rect.h));
+        return;
+    }
+    // Reused between calls, so that drawing a polygon does not allocate.
+    static thread_local QPolygon tmp;
+    PointView pts = polygon->points();
+    tmp.resize(int(pts.size()));
+    for (size_t i = 0; i < pts.size(); i++)
+        tmp[int(i)] = QPoint(pts[i].x, pts[i].y);
     painter.drawPolygon(tmp);
 }
 
-void PaintPath(QPainter &painter, std::shared_ptr<Element> data)
+void PaintPath(QPainter &painter, const std::shared_ptr<Element> &data)
 {
     auto path = std::dynamic_pointer_cast<Path>(data);
     if (!path)
         return;
     InitPainter(painter, path->layer(), path->data_type());
-    auto pts = path->xy();
+    PointView pts = path->points();
     if (pts.size() < 2)
         return;
     QPainterPath tmp;
@@ -109,53 +306,90 @@ void PaintPath(QPainter &painter, std::shared_ptr<Element> data)
     painter.fillPath(stroker.createStroke(tmp), painter.brush());
 }
 
-void PaintSRef(QPainter &painter, std::shared_ptr<Element> data, int level)
+void PaintSRef(QPainter &painter, const std::shared_ptr<Element> &data,
+               const PaintContext &context, int level)
 {
     auto sref = std::dynamic_pointer_cast<SRef>(data);
-    if (!sref)
+    if (!sref || !sref->reference())
         return;
-    PaintCell(painter, sref->reference(), level,
-              (sref->xy()).x, (sref->xy()).y,
-              sref->mag(), sref->angle(), sref->stransFlag(REFLECTION));
+    PaintCell(painter, sref->reference(), context, level,
+              Transform(sref->xy(), sref->mag(), sref->angle(), sref->stransFlag(REFLECTION)));
 }
 
-void PaintARef(QPainter &painter, std::shared_ptr<Element> data, int level)
+void PaintARef(QPainter &painter, const std::shared_ptr<Element> &data,
+               const PaintContext &context, int level)
 {
     auto aref = std::dynamic_pointer_cast<ARef>(data);
-    if (!aref)
+    if (!aref || !aref->reference())
+        return;
+    auto cell = aref->reference();
+    PointView pts = aref->points();
+    Box window, cell_box;
+    double scale;
+    if (pts.size() != 3 || aref->row() <= 0 || aref->col() <= 0
+        || !LocalWindow(painter, context, window, scale)
+        || !cell->bbox(cell_box.x, cell_box.y, cell_box.w, cell_box.h))
         return;
-    auto pts = aref->xy();
     int row_pitch_x = (pts[2].x - pts[0].x) / aref->row();
     int row_pitch_y = (pts[2].y - pts[0].y) / aref->row();
     int col_pitch_x = (pts[1].x - pts[0].x) / aref->col();
     int col_pitch_y = (pts[1].y - pts[0].y) / aref->col();
-    for (int i = 0; i < aref->row(); i++)
+    Transform transform(Point(0, 0), aref->mag(), aref->angle(), aref->stransFlag(REFLECTION));
+    // The box of the instance at the origin of the lattice.
+    Box base = cell_box;
+    transform.mapBox(base.x, base.y, base.w, base.h);
+
+    // Instances below the threshold merge into one box for the array.
+    if (std::max(base.w, base.h) * scale < context.options.min_pixels)
+    {
+        Box array;
+        aref->bbox(array.x, array.y, array.w, array.h);
+        PaintSmall(painter, *aref, array, context);
+        return;
+    }
+    const PaintContext::Stamp *stamp = nullptr;
+    if (std::max(base.w, base.h) * scale < context.options.stamp_pixels
+        && aref->row() * aref->col() > 1)
+        stamp = CellStamp(painter, cell, transform, level, context);
+    QTransform world = painter.transform();
+    if (stamp)
+        painter.setTransform(QTransform());
+    // Only the rows and columns crossing the window are visited.
+    int row_first, row_last, col_first, col_last;
+    bool exact = aref->placement_range(window, base, row_first, row_last, col_first, col_last);
+    for (int i = row_first; i <= row_last; i++)
     {
         int row_offset_x = pts[0].x + i * row_pitch_x;
         int row_offset_y = pts[0].y + i * row_pitch_y;
-        for (int j = 0; j < aref->col(); j++)
+        for (int j = col_first; j <= col_last; j++)
         {
             int cur_x = row_offset_x + j * col_pitch_x;
             int cur_y = row_offset_y + j * col_pitch_y;
-            PaintCell(painter, aref->reference(), level,
-                      cur_x, cur_y,
-                      aref->mag(), aref->angle(), aref->stransFlag(REFLECTION));
+            if (!exact && !Box(base.x + cur_x, base.y + cur_y, base.w, base.h).intersects(window))
+                continue;
+            if (stamp)
+            {
+                // Snapped to whole pixels, so that the bitmap is not resampled.
+                QPointF at = world.map(QPointF(cur_x, cur_y)) - stamp->origin;
+                painter.drawImage(QPointF(std::round(at.x()), std::round(at.y())), stamp->image);
+                continue;
+            }
+            PaintCell(painter, cell, context, level,
+                      transform.translated(cur_x, cur_y));
         }
     }
+    if (stamp)
+        painter.setTransform(world);
 }
 
-void PaintCell(QPainter &painter, std::shared_ptr<Structure> cell, int level, int offset_x, int offset_y, double mag, double angle, bool reflect)
+void PaintCell(QPainter &painter, std::shared_ptr<Structure> cell,
+               const PaintContext &context, int level, const Transform &transform)
 {
     QTransform back = painter.transform();
-    QTransform reflect_transform, mag_transform, rotate_transform, shift_transform;
-    if(reflect)
-        reflect_transform.scale(1, -1);
-    mag_transform.scale(mag, mag);
-    rotate_transform.rotate(angle);
-    shift_transform.translate(offset_x, offset_y);
-
-    QTransform transform = reflect_transform * mag_transform * rotate_transform * shift_transform;
-    painter.setTransform(transform, true);
+    // QTransform maps row vectors, so its m12 and m21 are swapped.
+    painter.setTransform(QTransform(transform.a(), transform.c(),
+                                    transform.b(), transform.d(),
+                                    transform.dx(), transform.dy()), true);
 
     if(level < 0)
         level = 99;
@@ -169,9 +403,22 @@ void PaintCell(QPainter &painter, std::shared_ptr<Structure> cell, int level, in
     }
     else
     {
-        for (size_t i = 0; i < cell->size(); i++)
+        Box window;
+        double scale = 0;
+        std::vector<int> indices;
+        if (LocalWindow(painter, context, window, scale))
+            cell->query(window, indices);
+        const std::vector<std::shared_ptr<Element> > &elements = cell->elements();
+        for (int i : indices)
         {
-            std::shared_ptr<Element> node = cell->get(i);
+            const std::shared_ptr<Element> &node = elements[i];
+            Box box;
+            node->bbox(box.x, box.y, box.w, box.h);
+            if (std::max(box.w, box.h) * scale < context.options.min_pixels)
+            {
+                PaintSmall(painter, *node, box, context);
+                continue;
+            }
             switch (node->tag())
             {
             case BOUNDARY:
@@ -181,10 +428,10 @@ void PaintCell(QPainter &painter, std::shared_ptr<Structure> cell, int level, in
                 PaintPath(painter, node);
                 break;
             case AREF:
-                PaintARef(painter, node, level - 1);
+                PaintARef(painter, node, context, level - 1);
                 break;
             case SREF:
-                PaintSRef(painter, node, level - 1);
+                PaintSRef(painter, node, context, level - 1);
                 break;
             default:
                 break;
@@ -194,27 +441,68 @@ void PaintCell(QPainter &painter, std::shared_ptr<Structure> cell, int level, in
     painter.setTransform(back);
 }
 
-void InitPainter(QPainter &painter, short layer, short purpose)
+void PaintCell(QPainter &painter, std::shared_ptr<Structure> cell, const QRectF &exposed,
+               const RenderOptions &options, int level)
 {
+    if (!cell)
+        return;
+    PaintContext context;
+    context.options = options;
+    context.device = exposed;
+    PaintCell(painter, cell, context, level);
+}
+
+struct PaintStyle
+{
+    QPen pen;
+    QBrush brush;
+};
+
+/*
+ * The pens and brushes of the layers, built from the techfile once and kept
+ * until its revision changes. Each painting thread has its own cache, so a
+ * hit takes no lock.
+ */
+struct PaintStyleCache
+{
+    unsigned int revision = 0;
+    std::unordered_map<int, PaintStyle> styles;
+};
+
+static const PaintStyle &LayerStyle(short layer, short purpose)
+{
+    static thread_local PaintStyleCache cache;
     Techfile& techfile = Techfile::instance();
-    int r, g, b;
-    bool flag;
-    flag = techfile.GetLayerColor(layer, purpose, r, g, b);
-    assert(flag);
-    std::string stipple_name;
-    StipplePattern stipple_pattern;
-    flag = techfile.GetLayerStippleName(layer, purpose, stipple_name);
-    assert(flag);
-    flag = techfile.GetLayerStipplePattern(layer, purpose, stipple_pattern);
+    unsigned int revision = techfile.revision();
+    if (cache.revision != revision)
+    {
+        cache.styles.clear();
+        cache.revision = revision;
+    }
+    int key = int((unsigned short)layer) << 16 | (unsigned short)purpose;
+    auto iter = cache.styles.find(key);
+    if (iter != cache.styles.end())
+        return iter->second;
+
+    DisplayLayerNode node("", "");
+    bool flag = techfile.GetDisplayLayer(layer, purpose, node);
     assert(flag);
-    QPen pen(QColor(r, g, b));
-   // pen.setWidth(1);
-    pen.setCosmetic(true);
-    painter.setPen(pen);
-    QBrush brush;
-    brush.setColor(QColor(r, g, b));
-    brush.setStyle(Qt::BrushStyle(kBuildInStipple[stipple_name]));
-    painter.setBrush(brush);
+    int r, g, b;
+    node.color(r, g, b);
+    PaintStyle style;
+    style.pen = QPen(QColor(r, g, b));
+    style.pen.setCosmetic(true);
+    style.brush.setColor(QColor(r, g, b));
+    auto stipple = kBuildInStipple.find(node.stipple_name());
+    style.brush.setStyle(Qt::BrushStyle(stipple == kBuildInStipple.end() ? 0 : stipple->second));
+    return cache.styles.emplace(key, style).first->second;
+}
+
+void InitPainter(QPainter &painter, short layer, short purpose)
+{
+    const PaintStyle &style = LayerStyle(layer, purpose);
+    painter.setPen(style.pen);
+    painter.setBrush(style.brush);
 }
 
 }
@@ -3,6 +3,7 @@
 
 #include <QtWidgets/QGraphicsItem>
 #include <QRectF>
+#include <QtGui/QColor>
 #include <memory>
 #include "tags.h"
 
@@ -10,6 +11,34 @@ namespace GDS
 {
 class Element;
 
+// Level of detail of the hierarchy drawn by the items.
+struct RenderOptions
+{
+    // Shapes and instances whose bounding box is smaller than this many
+    // pixels are not drawn in detail.
+    double min_pixels;
+    // Draw them as a filled box, or skip them.
+    bool draw_small;
+    // Color of the box standing for a small instance.
+    QColor small_cell_color;
+    // Arrays whose instances are smaller than this many pixels are drawn by
+    // rasterizing the cell once and stamping the bitmap at every placement.
+    // 0 always draws the shapes of each instance.
+    double stamp_pixels;
+
+    RenderOptions()
+        : min_pixels(2.0), draw_small(true), small_cell_color(128, 128, 128), stamp_pixels(256.0) {}
+};
+
+class Structure;
+
+// Paint the hierarchy under a cell with the painter's current transform,
+// down to `level` instances deep (all of it when negative). Only what falls
+// in `exposed`, given in device coordinates, is drawn. It may be called from
+// several threads at once, each with its own painter.
+void PaintCell(QPainter &painter, std::shared_ptr<Structure> cell, const QRectF &exposed,
+               const RenderOptions &options = RenderOptions(), int level = -1);
+
 class ViewItem : public QGraphicsItem
 {
 public:
@@ -21,9 +50,43 @@ public:
 
     Record_type tag() const;
     std::shared_ptr<Element> data();
+    void set_render_options(const RenderOptions &options) { options_ = options; }
 
 private:
     std::weak_ptr<Element> data_;
+    RenderOptions options_;
+};
+
+class TileRenderer;
+
+// The whole hierarchy of a cell as one item. Only the exposed part is drawn,
+// through the spatial index of the cell, so the scene holds a single item
+// however many shapes there are.
+class CellItem : public QGraphicsItem
+{
+public:
+    CellItem(std::shared_ptr<Structure> cell, QGraphicsItem *parent = 0);
+    virtual ~CellItem() {}
+
+    virtual QRectF boundingRect() const;
+    virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+    std::shared_ptr<Structure> cell() { return cell_; }
+    // The topmost element of the cell whose bounding box contains pos, or
+    // nullptr.
+    std::shared_ptr<Element> elementAt(const QPointF &pos) const;
+
+    void set_render_options(const RenderOptions &options) { options_ = options; }
+    void set_level(int level) { level_ = level; }
+    // Composite the tiles of a renderer instead of painting directly. The
+    // renderer must outlive the item.
+    void set_renderer(TileRenderer *renderer) { renderer_ = renderer; }
+
+private:
+    std::shared_ptr<Structure> cell_;
+    RenderOptions options_;
+    int level_;
+    TileRenderer *renderer_;
 };
 
 }
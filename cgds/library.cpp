@@ -20,11 +20,16 @@
  **/
 
 #include <assert.h>
+#include <algorithm>
 #include "library.h"
 #include "tags.h"
 #include "gdsio.h"
 #include <sstream>
 #include <ctime>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "techfile.h"
 #include "elements.h"
 #include "aref.h"
@@ -32,11 +37,200 @@
 #include "boundary.h"
 #include "path.h"
 #include "text.h"
+#include "arena.h"
 
 namespace GDS 
 {
 
+/*
+ * Intern the names read by a reader in a cache for the life of the scope.
+ **/
+class NameScope
+{
+	Reader    &In;
+	NameCache *Saved;
+
+public:
+	NameScope(Reader &in, NameCache *names)
+		: In(in), Saved(in.names())
+	{
+		In.set_names(names);
+	}
+	~NameScope()
+	{
+		In.set_names(Saved);
+	}
+};
+
+/*
+ * Skip the records of a structure up to and including its ENDSTR, without
+ * decoding them. Only the STRNAME is read.
+ **/
+static int SkipStructure(Reader &in, std::string &name, std::string &msg)
+{
+	while (1)
+	{
+		short record_size;
+		Byte record_type, record_dt;
+		if (!readShort(in, record_size)
+			|| !readByte(in, record_type)
+			|| !readByte(in, record_dt))
+			return FILE_ERROR;
+		size_t size = (unsigned short)record_size;
+		if (size < 4)
+		{
+			std::stringstream ss;
+			ss << "Wrong record size of " + Record_name[record_type] + " (";
+			ss << std::hex << record_size << record_type << record_dt;
+			ss << ").";
+			msg = ss.str();
+			return FORMAT_ERROR;
+		}
+		if (record_type == ENDSTR)
+			break;
+		if (record_type == STRNAME)
+		{
+			if (!readString(in, int(size - 4), name))
+				return FILE_ERROR;
+		}
+		else if (size > 4 && in.fetch(size - 4) == nullptr)
+			return FILE_ERROR;
+	}
+	return 0;
+}
+
+/*
+ * Parse the structures from their own readers on a pool of threads. On
+ * failure the error of the first failing structure in file order is
+ * reported.
+ **/
+static int ReadStructures(std::vector<std::shared_ptr<Structure> > &cells,
+	std::vector<Reader> &sources, const std::shared_ptr<NameTable> &names, unsigned int threads, bool use_arena,
+	std::string &msg)
+{
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+	std::mutex error_mutex;
+	size_t error_index = cells.size();
+	int error_code = 0;
+
+	auto worker = [&]()
+	{
+		// One arena and name cache per thread, so that they do not contend.
+		std::shared_ptr<Arena> arena = use_arena ? std::make_shared<Arena>() : nullptr;
+		NameCache cache(names);
+		while (!failed)
+		{
+			size_t i = next++;
+			if (i >= cells.size())
+				break;
+			std::string cell_msg;
+			cells[i]->set_arena(arena);
+			sources[i].set_names(&cache);
+			int code = cells[i]->read(sources[i], cell_msg);
+			if (code > 0)
+			{
+				std::lock_guard<std::mutex> lock(error_mutex);
+				if (i < error_index)
+				{
+					error_index = i;
+					error_code = code;
+					msg = cell_msg;
+				}
+				failed = true;
+			}
+		}
+	};
+
+	if (threads > cells.size())
+		threads = (unsigned int)cells.size();
+	std::vector<std::thread> pool;
+	for (unsigned int i = 1; i < threads; i++)
+		pool.push_back(std::thread(worker));
+	worker();
+	for (auto &t : pool)
+		t.join();
+
+	return error_code;
+}
+
+/*
+ * Encode the structures into their own buffers on a pool of threads and
+ * append the buffers to the output in order, as soon as each one is ready.
+ * At most a few buffers per thread are kept ahead of the output.
+ **/
+static int WriteStructures(std::vector<std::shared_ptr<Structure> > &cells,
+	Writer &out, unsigned int threads, std::string &msg)
+{
+	size_t window = 4 * size_t(threads);
+	std::vector<std::unique_ptr<Writer> > buffers(cells.size());
+	std::vector<int> codes(cells.size(), 0);
+	std::vector<std::string> msgs(cells.size());
+	std::vector<char> ready(cells.size(), 0);
+	std::mutex mutex;
+	std::condition_variable cond;
+	size_t next = 0;
+	size_t written = 0;
+	bool aborted = false;
+
+	auto worker = [&]()
+	{
+		while (1)
+		{
+			size_t i;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cond.wait(lock, [&]() { return aborted || next >= cells.size() || next < written + window; });
+				if (aborted || next >= cells.size())
+					break;
+				i = next++;
+			}
+			std::unique_ptr<Writer> buffer(new Writer());
+			int code = cells[i]->write(*buffer, msgs[i]);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				buffers[i] = std::move(buffer);
+				codes[i] = code;
+				ready[i] = 1;
+			}
+			cond.notify_all();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned int i = 0; i < threads; i++)
+		pool.push_back(std::thread(worker));
+
+	int error_code = 0;
+	for (size_t i = 0; i < cells.size(); i++)
+	{
+		std::unique_ptr<Writer> buffer;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [&]() { return ready[i] != 0; });
+			buffer = std::move(buffers[i]);
+			error_code = codes[i];
+			if (error_code > 0)
+			{
+				msg = msgs[i];
+				aborted = true;
+			}
+			written = i + 1;
+		}
+		cond.notify_all();
+		if (error_code > 0)
+			break;
+		out.write(buffer->data(), buffer->size());
+	}
+
+	for (auto &t : pool)
+		t.join();
+
+	return error_code;
+}
+
 Library::Library()
+	: Use_arena(false)
 {
 	init();
 }
@@ -70,6 +264,41 @@ void Library::init()
 	DBUnit_in_userunit = 1e-3;
 
 	Cells.clear();
+	CellIndex.clear();
+	Names = std::make_shared<NameTable>();
+	Self = std::make_shared<Library *>(this);
+}
+
+void Library::IndexCells()
+{
+	CellIndex.clear();
+	CellIndex.reserve(Cells.size());
+	for (auto e : Cells)
+	{
+		if (!e)
+			continue;
+		// Structures created elsewhere may have names of their own.
+		if (e->Names != Names)
+		{
+			e->Struct_name = Names->intern(e->name());
+			e->Names = Names;
+		}
+		// The first structure wins if a name is duplicated.
+		CellIndex.emplace(e->nameId(), e);
+	}
+}
+
+std::shared_ptr<Structure> Library::lookup(const NameTable *names, NameId name) const
+{
+	NameId id = name;
+	// A reference not added to a structure of this library may have its
+	// name in another table.
+	if (names != Names.get() && !Names->find(names->name(name), id))
+		return std::shared_ptr<Structure>();
+	auto iter = CellIndex.find(id);
+	if (iter == CellIndex.end())
+		return std::shared_ptr<Structure>();
+	return iter->second;
 }
 
 size_t Library::size() const
@@ -84,53 +313,45 @@ std::shared_ptr<Structure> Library::get(int index)
 	return Cells[index];
 }
 
-std::shared_ptr<Structure> Library::Add(std::string name)
+std::shared_ptr<Structure> Library::Add(std::string_view name)
 {
-    std::shared_ptr<Structure> ret;
-	for (auto e : Cells)
-	{
-		if (!e)
-			continue;
+	NameId id = Names->intern(name);
+	auto iter = CellIndex.find(id);
+	if (iter != CellIndex.end())
+		return iter->second;
 
-		if (e->name() == name)
-		{
-			ret = e;
-		}
-	}
-	if (!ret)
-	{
-		std::shared_ptr<Structure> new_item = std::make_shared<Structure>(name);
-		Cells.push_back(new_item);
-		ret = new_item;
-	}
+	std::shared_ptr<Structure> new_item = std::make_shared<Structure>(Names, id);
+	Cells.push_back(new_item);
+	CellIndex.emplace(new_item->nameId(), new_item);
 
-	return ret;
+	return new_item;
 }
 
-std::shared_ptr<Structure> Library::get(std::string name)
+std::shared_ptr<Structure> Library::get(std::string_view name)
 {
-	for (auto e : Cells)
-	{
-		if (!e)
-			continue;
-		if (e->name() == name)
-		{
-			return e;
-		}
-	}
-	return std::shared_ptr<Structure>();
+	NameId id;
+	if (!Names->find(name, id))
+		return std::shared_ptr<Structure>();
+	return lookup(Names.get(), id);
 }
 
-void Library::Del(std::string name)
+void Library::Del(std::string_view name)
 {
-	for (size_t i = 0; i < size(); i++)
+	NameId id;
+	if (!Names->find(name, id))
+		return;
+	auto iter = CellIndex.find(id);
+	if (iter == CellIndex.end())
+		return;
+	std::shared_ptr<Structure> node = iter->second;
+	CellIndex.erase(iter);
+	Cells.erase(std::find(Cells.begin(), Cells.end(), node));
+	// Another structure with the same name may have been shadowed.
+	for (auto e : Cells)
 	{
-		auto node = Cells[i];
-		if (!node)
-			continue;
-		if (node->name() == name)
+		if (e && e->nameId() == id)
 		{
-			Cells.erase(Cells.begin() + i);
+			CellIndex.emplace(id, e);
 			break;
 		}
 	}
@@ -140,67 +361,135 @@ void Library::BuildCellLinks(bool del_dirty_links)
 {
 	for (auto cell : Cells)
 	{
+		std::vector<std::shared_ptr<Element> > dirty;
 		for (size_t i = 0; i < cell->size(); i++)
 		{
 			auto element = cell->get(i);
+			std::shared_ptr<Structure> source_cell;
 			if (element->tag() == SREF)
 			{
 				auto temp = std::dynamic_pointer_cast<SRef>(element);
-				std::string sname = temp->structName();
-				auto source_cell = get(sname);
-                temp->set_reference(source_cell);
-                source_cell->AddReferBy(cell);
+				source_cell = lookup(temp->names(), temp->structId());
+				if (source_cell)
+					temp->set_reference(source_cell);
 			}
 			else if (element->tag() == AREF)
 			{
 				auto temp = std::dynamic_pointer_cast<ARef>(element);
-				std::string sname = temp->structName();
-				auto source_cell = get(sname);
-                temp->set_reference(source_cell);
-                source_cell->AddReferBy(cell);
+				source_cell = lookup(temp->names(), temp->structId());
+				if (source_cell)
+					temp->set_reference(source_cell);
 			}
+			else
+				continue;
+			if (source_cell)
+				source_cell->AddReferBy(cell);
+			else if (del_dirty_links)
+				dirty.push_back(element);
 		}
+		for (auto &element : dirty)
+			cell->Del(element);
+		// Cached bounding boxes may predate the links.
+		cell->Invalidate();
 	}
 }
 
+void Library::set_arena(bool enable)
+{
+	Use_arena = enable;
+}
+
 void Library::CollectLayers(Techfile &tech_file)
 {
     for (auto cell : Cells)
     {
-        for (size_t i = 0; i < cell->size(); i++)
+        for (auto &shapes : *cell->layers())
+            tech_file.AddLayer(shapes.layer, shapes.datatype);
+        for (auto &element : cell->elements())
         {
-            auto element = cell->get(i);
-            switch (element->tag())
-            {
-            case BOUNDARY:
-            {
-                auto boundary = std::dynamic_pointer_cast<Boundary>(element);
-                tech_file.AddLayer(boundary->layer(), boundary->data_type());
-                break;
-            }
-            case PATH:
-            {
-                auto path = std::dynamic_pointer_cast<Path>(element);
-                tech_file.AddLayer(path->layer(), path->data_type());
-                break;
-            }
-            case TEXT:
-            {
-                auto text = std::dynamic_pointer_cast<Text>(element);
-                tech_file.AddLayer(text->layer(), text->text_type());
-                break;
-            }
-            default:
-                break;
-            }
+            if (element->tag() != TEXT)
+                continue;
+            auto text = std::static_pointer_cast<Text>(element);
+            tech_file.AddLayer(text->layer(), text->text_type());
         }
     }
 }
 
 int Library::read(std::ifstream &in, std::string &msg)
+{
+	Reader reader(in);
+	return read(reader, msg);
+}
+
+int Library::read(const std::string &file_name, std::string &msg, unsigned int threads)
+{
+	Reader reader;
+	if (reader.open(file_name))
+		return read(reader, msg, threads);
+
+	std::ifstream in(file_name, std::ifstream::binary);
+	if (!in.is_open())
+	{
+		msg = "Can not open " + file_name + ".";
+		return FILE_ERROR;
+	}
+	return read(in, msg);
+}
+
+int Library::read(Reader &in, std::string &msg, unsigned int threads)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	return parse(in, msg, threads, false);
+}
+
+int Library::open(const std::string &file_name, std::string &msg)
+{
+	Reader reader;
+	if (!reader.open(file_name))
+		return read(file_name, msg);
+	return parse(reader, msg, 1, true);
+}
+
+void Library::LinkCell(Structure &cell)
+{
+	std::lock_guard<std::mutex> lock(Link_mutex);
+	auto self = CellIndex.find(cell.nameId());
+	for (size_t i = 0; i < cell.size(); i++)
+	{
+		auto element = cell.get(i);
+		std::shared_ptr<Structure> source_cell;
+		if (element->tag() == SREF)
+		{
+			auto temp = std::dynamic_pointer_cast<SRef>(element);
+			source_cell = lookup(temp->names(), temp->structId());
+			if (!source_cell)
+				continue;
+			temp->set_reference(source_cell);
+		}
+		else if (element->tag() == AREF)
+		{
+			auto temp = std::dynamic_pointer_cast<ARef>(element);
+			source_cell = lookup(temp->names(), temp->structId());
+			if (!source_cell)
+				continue;
+			temp->set_reference(source_cell);
+		}
+		if (source_cell && self != CellIndex.end())
+			source_cell->AddReferBy(self->second);
+	}
+}
+
+int Library::parse(Reader &in, std::string &msg, unsigned int threads, bool lazy)
 {
 	msg = "";
 	init();
+	bool parallel = !lazy && threads > 1 && in.mapped();
+	std::vector<Reader> sources;
+	std::shared_ptr<Arena> arena = Use_arena ? std::make_shared<Arena>() : nullptr;
+	NameCache names(Names);
+	NameScope scope(in, &names);
+
 	// read HEADER
 	short record_size;
 	Byte record_type, record_dt;
@@ -319,9 +608,44 @@ int Library::read(std::ifstream &in, std::string &msg)
 				return FORMAT_ERROR;
 			}
 			std::shared_ptr<Structure> node = std::make_shared<Structure>();
-			int error_code = node->read(in, msg);
-			if (error_code > 0)
-				return error_code;
+			node->set_arena(arena);
+			if (parallel || lazy)
+			{
+				size_t begin = in.tell();
+				if (in.fetch(record_size - 4) == nullptr)
+					return FILE_ERROR;
+				std::string name;
+				int error_code = SkipStructure(in, name, msg);
+				if (error_code > 0)
+					return error_code;
+				Reader source = in.range(begin, in.tell());
+				if (lazy)
+				{
+					node = std::make_shared<Structure>(Names, Names->intern(name));
+					node->set_arena(arena);
+					std::weak_ptr<Library *> owner = Self;
+					node->set_loader([owner, source](Structure &cell, std::string &cell_msg) mutable
+					{
+						NameCache cache(cell.names());
+						source.set_names(&cache);
+						int code = cell.read(source, cell_msg);
+						source.set_names(nullptr);
+						if (code > 0)
+							return code;
+						if (auto library = owner.lock())
+							(*library)->LinkCell(cell);
+						return 0;
+					});
+				}
+				else
+					sources.push_back(source);
+			}
+			else
+			{
+				int error_code = node->read(in, msg);
+				if (error_code > 0)
+					return error_code;
+			}
 			Cells.push_back(node);
 			break;
 		}
@@ -332,11 +656,31 @@ int Library::read(std::ifstream &in, std::string &msg)
 			break;
 	}
 
+	if (parallel)
+	{
+		int error_code = ReadStructures(Cells, sources, Names, threads, Use_arena, msg);
+		if (error_code > 0)
+			return error_code;
+	}
+	IndexCells();
+
 	return 0;
 }
 
-int Library::write(std::ofstream &out, std::string &msg)
+int Library::write(std::ofstream &out, std::string &msg, unsigned int threads)
 {
+	Writer writer(out);
+	int error_code = write(writer, msg, threads);
+	if (!writer.flush() && error_code == 0)
+		error_code = FILE_ERROR;
+	return error_code;
+}
+
+int Library::write(Writer &out, std::string &msg, unsigned int threads)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+
     short record_size;
 
 	record_size = 6;
@@ -377,12 +721,21 @@ int Library::write(std::ofstream &out, std::string &msg)
 	writeDouble(out, DBUnit_in_userunit);
 	writeDouble(out, DBUnit_in_meter);
 
-	for (auto e : Cells)
+	if (threads > 1 && Cells.size() > 1)
 	{
-		int err_code = e->write(out, msg);
+		int err_code = WriteStructures(Cells, out, threads, msg);
 		if (err_code > 0)
 			return err_code;
 	}
+	else
+	{
+		for (auto e : Cells)
+		{
+			int err_code = e->write(out, msg);
+			if (err_code > 0)
+				return err_code;
+		}
+	}
 
 	record_size = 4;
 	writeShort(out, record_size);
@@ -23,14 +23,19 @@
 #define LIBRARY_H
 
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include "structures.h"
 
 namespace GDS 
 {
 class Techfile;
+class Reader;
+class Writer;
 
 class Library {
 	short           Version;
@@ -51,8 +56,22 @@ class Library {
 	double          DBUnit_in_userunit;
 
 	std::vector<std::shared_ptr<Structure> > Cells;
+	// Names of the structures and references read into this library.
+	std::shared_ptr<NameTable> Names;
+	// Name index of Cells, by interned name.
+	std::unordered_map<NameId, std::shared_ptr<Structure> > CellIndex;
+
+	std::mutex      Link_mutex;
+	bool            Use_arena;
+	// Held weakly by the loaders of the structures, which only link a
+	// structure while its library is alive. Renewed by init().
+	std::shared_ptr<Library *> Self;
+
+	void IndexCells();
+	std::shared_ptr<Structure> lookup(const NameTable *names, NameId name) const;
+	void LinkCell(Structure &cell);
+	int parse(Reader &in, std::string &msg, unsigned int threads, bool lazy);
 
-		
 public:
 	Library();
 	~Library();
@@ -61,7 +80,7 @@ public:
 
 	size_t size() const;
 	std::shared_ptr<Structure> get(int index);
-	std::shared_ptr<Structure> get(std::string name);
+	std::shared_ptr<Structure> get(std::string_view name);
 	/*!
 		* Add a new structure into library. If there is a structure existed in library which
 		* have the same name, it will cause the failure of process.
@@ -71,18 +90,112 @@ public:
 		* \return	The pointer to the new structure. If failed to add the new structure, the
 		*			return value will be nullptr.
 		*/
-    std::shared_ptr<Structure> Add(std::string name);
+    std::shared_ptr<Structure> Add(std::string_view name);
 	/*!
 		* Delete a structure in the library.
 		*
 		* \param [in] name			Name of structure.
 		*/
-    void Del(std::string name);
+    void Del(std::string_view name);
+	/*!
+		* Link the references of every structure to the structures they name.
+		* References to structures missing from the library are left unlinked.
+		*
+		* \param [in] del_dirty_links	Remove the references to missing structures instead.
+		*/
     void BuildCellLinks(bool del_dirty_links = false);
+	/*!
+		* Allocate the elements of the structures read from now on, and their
+		* points, in large chunks instead of one by one (parallel reads use
+		* one arena per thread). The structures own the arenas and release
+		* them at once with the last structure using them, so the elements
+		* must not outlive the library and its structures.
+		*
+		* \param [in] enable		Use arenas for the following reads.
+		*/
+	void set_arena(bool enable);
     void CollectLayers(Techfile &tech_file);
 
 	int read(std::ifstream &in, std::string &msg);
-	int write(std::ofstream &out, std::string &msg);
+	/*!
+		* Read a GDSII file. The file is memory-mapped and decoded in place;
+		* if it can not be mapped (e.g. a pipe) it is read as a stream.
+		*
+		* \param [in] file_name	Path of the GDSII file.
+		* \param [out] msg		The error message if the file is malformed.
+		* \param [in] threads	Number of threads parsing the structures. If it
+		*						is not 1, the structures are located by a scan
+		*						of the record headers first and then parsed in
+		*						parallel. 0 means one thread per core.
+		*
+		* \return	0 on success, otherwise FILE_ERROR or FORMAT_ERROR.
+		*/
+	int read(const std::string &file_name, std::string &msg, unsigned int threads = 1);
+	int read(Reader &in, std::string &msg, unsigned int threads = 1);
+	/*!
+		* Open a GDSII file lazily. Only the record headers are scanned to build a
+		* table of contents of the structures; the elements of a structure are
+		* parsed the first time they are needed, and its references are linked
+		* then, so BuildCellLinks is not required. Files which can not be mapped
+		* are read at once. A structure loaded after the library is destroyed
+		* or read again gets its elements, but its references are not linked.
+		*
+		* A malformed structure is only detected when it is loaded; then it is
+		* left empty and Structure::load(), write() and write_snapshot()
+		* return its error.
+		*
+		* \param [in] file_name	Path of the GDSII file.
+		* \param [out] msg		The error message if the file is malformed.
+		*
+		* \return	0 on success, otherwise FILE_ERROR or FORMAT_ERROR.
+		*/
+	int open(const std::string &file_name, std::string &msg);
+	/*!
+		* Write the library as a GDSII stream.
+		*
+		* \param [out] out		The output stream.
+		* \param [out] msg		The error message.
+		* \param [in] threads	Number of threads encoding the structures. If it
+		*						is not 1, every structure is encoded into its
+		*						own buffer on a pool of threads and the buffers
+		*						are written in order; the output is the same.
+		*						0 means one thread per core.
+		*
+		* \return	0 on success, otherwise FILE_ERROR or FORMAT_ERROR.
+		*/
+	int write(std::ofstream &out, std::string &msg, unsigned int threads = 1);
+	int write(Writer &out, std::string &msg, unsigned int threads = 1);
+
+	/*!
+		* Save the library in the native snapshot format: a flat, aligned,
+		* little-endian image of the structures, elements and points which
+		* open_snapshot() maps back without decoding GDSII records. EFLAGS are
+		* not kept.
+		*
+		* \param [in] file_name		Path of the snapshot.
+		* \param [in] source_name	Path of the GDSII file the library was read
+		*							from. Its size and modification time are
+		*							recorded to detect stale snapshots.
+		* \param [out] msg			The error message.
+		*
+		* \return	0 on success, otherwise FILE_ERROR or FORMAT_ERROR.
+		*/
+	int write_snapshot(const std::string &file_name, const std::string &source_name, std::string &msg);
+	/*!
+		* Open a snapshot saved by write_snapshot(). Like open(), the elements of
+		* a structure are only built when they are first needed, and only
+		* linked while the library is alive.
+		*
+		* \param [in] file_name		Path of the snapshot.
+		* \param [in] source_name	Path of the GDSII file the snapshot was made
+		*							from.
+		* \param [out] msg			The error message.
+		*
+		* \return	0 on success. FILE_ERROR if the snapshot can not be mapped or
+		*			does not match the size and modification time of the source
+		*			file, in which case the source should be read again.
+		*/
+	int open_snapshot(const std::string &file_name, const std::string &source_name, std::string &msg);
 };
 }
 
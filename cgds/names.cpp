@@ -0,0 +1,139 @@
+/*
+ * This file is part of GDSII.
+ *
+ * names.cpp -- The file which implements the table of structure names.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include <assert.h>
+#include <mutex>
+#include "names.h"
+
+namespace GDS
+{
+
+/*
+ * The block of an index, and the index of its first name.
+ **/
+static int BlockOf(uint32_t id, uint32_t block_size, uint32_t &first)
+{
+	int block = 0;
+	for (uint32_t n = id / block_size + 1; n > 1; n >>= 1)
+		block++;
+	first = block_size * ((uint32_t(1) << block) - 1);
+	return block;
+}
+
+NameTable::NameTable()
+	: Count(1)
+{
+	for (auto &block : Blocks)
+		block.store(nullptr, std::memory_order_relaxed);
+	// Index 0 is the empty name.
+	Blocks[0].store(new std::string[kBlock], std::memory_order_release);
+}
+
+NameTable::~NameTable()
+{
+	for (auto &block : Blocks)
+		delete[] block.load(std::memory_order_relaxed);
+}
+
+NameId NameTable::intern(std::string_view name)
+{
+	if (name.empty())
+		return 0;
+	{
+		std::shared_lock<std::shared_mutex> lock(Mutex);
+		auto iter = Ids.find(name);
+		if (iter != Ids.end())
+			return iter->second;
+	}
+	std::unique_lock<std::shared_mutex> lock(Mutex);
+	// Another thread may have added it in the meantime.
+	auto iter = Ids.find(name);
+	if (iter != Ids.end())
+		return iter->second;
+	NameId id = Count;
+	assert(id != 0);
+	uint32_t first;
+	int block = BlockOf(id, kBlock, first);
+	std::string *names = Blocks[block].load(std::memory_order_relaxed);
+	if (names == nullptr)
+	{
+		names = new std::string[size_t(kBlock) << block];
+		Blocks[block].store(names, std::memory_order_release);
+	}
+	std::string &slot = names[id - first];
+	slot.assign(name.data(), name.size());
+	Ids.emplace(slot, id);
+	Count++;
+	return id;
+}
+
+bool NameTable::find(std::string_view name, NameId &id) const
+{
+	if (name.empty())
+	{
+		id = 0;
+		return true;
+	}
+	std::shared_lock<std::shared_mutex> lock(Mutex);
+	auto iter = Ids.find(name);
+	if (iter == Ids.end())
+		return false;
+	id = iter->second;
+	return true;
+}
+
+const std::string &NameTable::name(NameId id) const
+{
+	uint32_t first;
+	int block = BlockOf(id, kBlock, first);
+	return Blocks[block].load(std::memory_order_acquire)[id - first];
+}
+
+size_t NameTable::size() const
+{
+	std::shared_lock<std::shared_mutex> lock(Mutex);
+	return Ids.size();
+}
+
+const std::shared_ptr<NameTable> &NameTable::detached()
+{
+	static const std::shared_ptr<NameTable> table = std::make_shared<NameTable>();
+	return table;
+}
+
+NameCache::NameCache(std::shared_ptr<NameTable> table)
+	: Table(std::move(table))
+{
+}
+
+NameId NameCache::intern(std::string_view name)
+{
+	auto iter = Ids.find(name);
+	if (iter != Ids.end())
+		return iter->second;
+	NameId id = Table->intern(name);
+	if (id != 0)
+		Ids.emplace(Table->name(id), id);
+	return id;
+}
+
+}
@@ -0,0 +1,116 @@
+/*
+ * This file is part of GDSII.
+ *
+ * names.h -- The header file which declare the table of structure names.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#ifndef NAMES_H
+#define NAMES_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace GDS {
+
+/*!
+	* Index of an interned name in its NameTable. Within a table, equal names
+	* have the same index, so they compare in O(1); 0 is the empty name.
+	*/
+typedef uint32_t NameId;
+
+/*!
+	* \brief Table of the structure names referred to by the structures, SREFs
+	* and AREFs of a library.
+	*
+	* Each distinct name is stored once per table and never moves, so name()
+	* does not lock. The table belongs to its library and to the structures
+	* of the library, and is dropped with the last of them. It is safe to use
+	* from several threads.
+	*/
+class NameTable {
+	// Block b holds the names [kBlock * (2^b - 1), kBlock * (2^(b+1) - 1)).
+	static const uint32_t kBlock = 64;
+	static const int kBlocks = 27;
+
+	mutable std::shared_mutex                   Mutex;
+	// The keys view the strings of Blocks.
+	std::unordered_map<std::string_view, NameId> Ids;
+	std::atomic<std::string *>                  Blocks[kBlocks];
+	uint32_t                                    Count;
+
+public:
+	NameTable();
+	~NameTable();
+	NameTable(const NameTable &) = delete;
+	NameTable &operator=(const NameTable &) = delete;
+
+	/*!
+		* The index of a name, added to the table if it is new.
+		*/
+	NameId intern(std::string_view name);
+	/*!
+		* Look a name up without adding it.
+		*
+		* \param [in] name		The name.
+		* \param [out] id		Its index, if it was found.
+		*
+		* \return	Whether the name is in the table.
+		*/
+	bool find(std::string_view name, NameId &id) const;
+	/*!
+		* The name of an index returned by this table.
+		*/
+	const std::string &name(NameId id) const;
+	size_t size() const;
+
+	/*!
+		* The table of the names set outside a library, e.g. by
+		* set_struct_name() on a new reference. Structure::Add() moves the
+		* name of a reference to the table of the structure. The table lives
+		* as long as the program, so it is meant for names set by hand, not
+		* for names read from files.
+		*/
+	static const std::shared_ptr<NameTable> &detached();
+};
+
+/*!
+	* \brief Names interned by one thread, in front of a NameTable.
+	*
+	* It remembers the indices it has returned, so that a thread parsing many
+	* references to the same structures takes the lock of the table once per
+	* distinct name. It is not safe to use from several threads.
+	*/
+class NameCache {
+	std::shared_ptr<NameTable>                   Table;
+	std::unordered_map<std::string_view, NameId> Ids;
+
+public:
+	explicit NameCache(std::shared_ptr<NameTable> table);
+
+	NameId intern(std::string_view name);
+	const std::shared_ptr<NameTable> &table() const { return Table; }
+};
+
+}
+
+#endif // NAMES_H
@@ -28,7 +28,11 @@
 namespace GDS
 {
 
-Path::Path() :Element(PATH)
+Path::Path() :Path(std::pmr::get_default_resource())
+{
+}
+
+Path::Path(std::pmr::memory_resource *resource) :Element(PATH), Pts(resource)
 {
 	Eflags = 0;
 	Layer = -1;
@@ -64,7 +68,12 @@ short Path::path_type() const
 
 std::vector<Point> Path::xy() const
 {
-	return Pts;
+	return std::vector<Point>(Pts.begin(), Pts.end());
+}
+
+PointView Path::points() const
+{
+	return PointView(Pts.data(), Pts.size());
 }
 
 void Path::set_layer(short layer)
@@ -89,8 +98,17 @@ void Path::set_path_type(short type)
 
 void Path::set_xy(const std::vector<Point> &pts)
 {
-	Pts.clear();
-	Pts = pts;
+	Pts.assign(pts.begin(), pts.end());
+}
+
+void Path::set_xy(PointArray &&pts)
+{
+	Pts = std::move(pts);
+}
+
+void Path::set_xy(std::initializer_list<Point> pts)
+{
+	Pts.assign(pts.begin(), pts.end());
 }
 
 bool Path::bbox(int &x, int &y, int &w, int &h) const
@@ -165,7 +183,7 @@ bool Path::bbox(int &x, int &y, int &w, int &h) const
 	return true;
 }
 
-int Path::read(std::ifstream &in, std::string &msg)
+int Path::read(Reader &in, std::string &msg)
 {
 	msg = "";
 	bool finished = false;
@@ -234,14 +252,8 @@ int Path::read(std::ifstream &in, std::string &msg)
 				msg = ss.str();
 				return FORMAT_ERROR;
 			}
-			for (int i = 0; i < num; i++)
-			{
-				int x, y;
-				if (!readInteger(in, x)
-					|| !readInteger(in, y))
-					return FILE_ERROR;
-				Pts.push_back(Point(x, y));
-			}
+			if (!readPoints(in, num, Pts))
+				return FILE_ERROR;
 			break;
 		}
 		case WIDTH:
@@ -278,7 +290,7 @@ int Path::read(std::ifstream &in, std::string &msg)
 	return 0;
 }
 
-int Path::write(std::ofstream &out, std::string &msg)
+int Path::write(Writer &out, std::string &msg)
 {
 	short record_size;
 
@@ -321,11 +333,7 @@ int Path::write(std::ofstream &out, std::string &msg)
 	writeShort(out, record_size);
 	writeByte(out, XY);
 	writeByte(out, Integer_4);
-	for (auto p : Pts)
-	{
-		writeInteger(out, p.x);
-		writeInteger(out, p.y);
-	}
+	writePoints(out, Pts);
 
 	record_size = 4;
 	writeShort(out, record_size);
@@ -47,10 +47,14 @@ class Path : public Element {
 	short               Data_type;
 	int                 Width;
 	short               Path_type;
-	std::vector<Point>  Pts;
+	PointArray          Pts;
 
 public:
 	Path();
+	/*!
+		* Construct with the points allocated from the given memory resource.
+		*/
+	explicit Path(std::pmr::memory_resource *resource);
 	virtual ~Path();
 
 	short layer() const;
@@ -58,6 +62,10 @@ public:
 	int width() const;
     short path_type() const;
 	std::vector<Point> xy() const;
+	/*!
+		* The points without copying them, see PointView.
+		*/
+	PointView points() const;
 	virtual bool bbox(int &x, int &y, int &w, int &h) const;
 
     void set_layer(short layer);
@@ -65,9 +73,15 @@ public:
     void set_width(int width);
     void set_path_type(short type);
     void set_xy(const std::vector<Point> &pts);
+	/*!
+		* Take over the points. Their storage is kept when it comes from the
+		* same memory resource as the path, see Structure::set_arena().
+		*/
+	void set_xy(PointArray &&pts);
+	void set_xy(std::initializer_list<Point> pts);
 
-	virtual int read(std::ifstream &in, std::string &msg);
-	virtual int write(std::ofstream &out, std::string &msg);
+	virtual int read(Reader &in, std::string &msg);
+	virtual int write(Writer &out, std::string &msg);
 };
 
 }
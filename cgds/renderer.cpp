@@ -0,0 +1,274 @@
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <QtCore/QRunnable>
+#include "renderer.h"
+#include "structures.h"
+#include "techfile.h"
+
+namespace GDS
+{
+
+QImage RenderCell(std::shared_ptr<Structure> cell, const QSize &size, int level,
+                  const RenderOptions &options)
+{
+    if (size.isEmpty())
+        return QImage();
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    int x, y, w, h;
+    if (!cell || !cell->bbox(x, y, w, h))
+        return image;
+    // A pixel of margin for the cosmetic pens on the edges.
+    double fit_x = (size.width() - 2) / double(std::max(w, 1));
+    double fit_y = (size.height() - 2) / double(std::max(h, 1));
+    double scale = std::max(std::min(fit_x, fit_y), 0.0);
+    if (!(scale > 0))
+        return image;
+    double center_x = x + w / 2.0;
+    double center_y = y + h / 2.0;
+    QPainter painter(&image);
+    painter.setTransform(QTransform(scale, 0, 0, -scale,
+                                    size.width() / 2.0 - center_x * scale,
+                                    size.height() / 2.0 + center_y * scale));
+    PaintCell(painter, cell, QRectF(0, 0, size.width(), size.height()), options, level);
+    painter.end();
+    return image;
+}
+
+std::vector<QImage> RenderCells(const std::vector<std::shared_ptr<Structure> > &cells,
+                                const QSize &size, int level,
+                                const RenderOptions &options, unsigned int threads)
+{
+    std::vector<QImage> images(cells.size());
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    threads = std::max(1u, std::min<unsigned int>(threads, unsigned(cells.size())));
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            size_t i = next++;
+            if (i >= cells.size())
+                break;
+            images[i] = RenderCell(cells[i], size, level, options);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < threads; i++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &t : pool)
+        t.join();
+    return images;
+}
+
+// Rasterizes one tile on the pool.
+class TileRenderer::Job : public QRunnable
+{
+public:
+    Job(TileRenderer *owner, const TileKey &key, double scale,
+        std::shared_ptr<Structure> cell, const RenderOptions &options, int level,
+        unsigned long long generation)
+        : owner_(owner), key_(key), scale_(scale), cell_(cell), options_(options),
+          level_(level), generation_(generation)
+    {
+    }
+
+    virtual void run()
+    {
+        QImage image(kTileSize, kTileSize, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        // The tile starts at pixel (x, y) * kTileSize of the cell drawn at scale_.
+        painter.setTransform(QTransform(scale_, 0, 0, scale_,
+                                        -double(key_.x) * kTileSize, -double(key_.y) * kTileSize));
+        PaintCell(painter, cell_, QRectF(0, 0, kTileSize, kTileSize), options_, level_);
+        painter.end();
+        owner_->finish(key_, generation_, image);
+    }
+
+private:
+    TileRenderer *owner_;
+    TileKey key_;
+    double scale_;
+    std::shared_ptr<Structure> cell_;
+    RenderOptions options_;
+    int level_;
+    unsigned long long generation_;
+};
+
+TileRenderer::TileRenderer(std::shared_ptr<Structure> cell, int threads)
+    : cell_(cell), level_(-1), capacity_(96), generation_(0), zoom_(0), edit_(0)
+{
+    if (threads > 0)
+        pool_.setMaxThreadCount(threads);
+}
+
+TileRenderer::~TileRenderer()
+{
+    clear();
+    pool_.waitForDone();
+}
+
+void TileRenderer::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+    tiles_.clear();
+    lru_.clear();
+    pending_.clear();
+    pool_.clear();
+}
+
+void TileRenderer::quiesce()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // The cancelled tiles are scheduled again when next drawn.
+        pending_.clear();
+        pool_.clear();
+    }
+    // Not under mutex_, which the finishing jobs take.
+    pool_.waitForDone();
+}
+
+void TileRenderer::set_cell(std::shared_ptr<Structure> cell)
+{
+    clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    cell_ = cell;
+}
+
+void TileRenderer::set_render_options(const RenderOptions &options)
+{
+    clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+}
+
+void TileRenderer::set_level(int level)
+{
+    clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    level_ = level;
+}
+
+void TileRenderer::set_ready(std::function<void()> ready)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready_ = ready;
+}
+
+void TileRenderer::set_capacity(size_t tiles)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = std::max<size_t>(tiles, 1);
+    trim();
+}
+
+void TileRenderer::trim()
+{
+    while (lru_.size() > capacity_)
+    {
+        tiles_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
+
+void TileRenderer::draw(QPainter &painter, const QRectF &rect)
+{
+    const QTransform &world = painter.transform();
+    double scale = std::sqrt(std::fabs(world.m11() * world.m22() - world.m12() * world.m21()));
+    if (!cell_ || !(scale > 0) || rect.isEmpty())
+        return;
+    // Tiles are drawn at the nearest quarter octave and stretched to the
+    // exact zoom, so that a zoom level is reused by nearby zooms.
+    int zoom = int(std::lround(std::log2(scale) * 4));
+    double tile_scale = std::exp2(zoom / 4.0);
+    double span = kTileSize / tile_scale;
+    double limit = double(GDS_MAX_INT / 2);
+    int x0 = int(std::max(std::floor(rect.left() / span), -limit));
+    int x1 = int(std::min(std::floor(rect.right() / span), limit));
+    int y0 = int(std::max(std::floor(rect.top() / span), -limit));
+    int y1 = int(std::min(std::floor(rect.bottom() / span), limit));
+    unsigned int revision = Techfile::instance().revision();
+    unsigned long long edit = cell_->revision();
+
+    std::vector<std::pair<QRectF, QImage> > ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (edit != edit_)
+        {
+            // The cell has changed, so none of its tiles, drawn or queued,
+            // can be used again.
+            generation_++;
+            tiles_.clear();
+            lru_.clear();
+            pending_.clear();
+            pool_.clear();
+            edit_ = edit;
+        }
+        if (zoom != zoom_)
+        {
+            // Tiles still queued for the previous zoom would only delay these.
+            pool_.clear();
+            pending_.clear();
+            zoom_ = zoom;
+        }
+        for (int y = y0; y <= y1; y++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                TileKey key = { cell_.get(), edit, revision, zoom, x, y };
+                auto iter = tiles_.find(key);
+                if (iter == tiles_.end())
+                {
+                    if (pending_.insert(key).second)
+                        schedule(key, tile_scale);
+                    continue;
+                }
+                lru_.splice(lru_.begin(), lru_, iter->second);
+                ready.emplace_back(QRectF(x * span, y * span, span, span), iter->second->second);
+            }
+        }
+    }
+    for (auto &tile : ready)
+        painter.drawImage(tile.first, tile.second);
+}
+
+void TileRenderer::schedule(const TileKey &key, double scale)
+{
+    pool_.start(new Job(this, key, scale, cell_, options_, level_, generation_));
+}
+
+void TileRenderer::finish(const TileKey &key, unsigned long long generation, const QImage &image)
+{
+    std::function<void()> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != generation_)
+            return;
+        pending_.erase(key);
+        auto iter = tiles_.find(key);
+        if (iter != tiles_.end())
+        {
+            iter->second->second = image;
+            lru_.splice(lru_.begin(), lru_, iter->second);
+        }
+        else
+        {
+            lru_.emplace_front(key, image);
+            tiles_.emplace(key, lru_.begin());
+            trim();
+        }
+        ready = ready_;
+    }
+    if (ready)
+        ready();
+}
+
+}
@@ -0,0 +1,135 @@
+#ifndef GDS_RENDERER_H
+#define GDS_RENDERER_H
+#include <QtCore/QThreadPool>
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+#include <QRectF>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "graphicsitems.h"
+
+namespace GDS
+{
+class Structure;
+
+// Render a cell into an image of the given size with no widget or event
+// loop, fitted and centered with the y axis up, on a transparent background.
+// Drawing the names of cells at the last level needs a QGuiApplication
+// (e.g. with the "offscreen" platform) for the fonts; shapes do not.
+QImage RenderCell(std::shared_ptr<Structure> cell, const QSize &size, int level = -1,
+                  const RenderOptions &options = RenderOptions());
+// Render many cells in parallel, e.g. for thumbnails. The images are in the
+// order of the cells. If threads is 0, one thread per core is used.
+std::vector<QImage> RenderCells(const std::vector<std::shared_ptr<Structure> > &cells,
+                                const QSize &size, int level = -1,
+                                const RenderOptions &options = RenderOptions(),
+                                unsigned int threads = 0);
+
+// A square of pixels of a cell drawn at one zoom level.
+struct TileKey
+{
+    const Structure *cell;
+    // Structure::revision() of the cell the tile was drawn from.
+    unsigned long long edit;
+    // Techfile revision the tile was drawn with.
+    unsigned int revision;
+    // Zoom level, a quarter of an octave each.
+    int zoom;
+    int x, y;
+
+    bool operator==(const TileKey &other) const
+    {
+        return cell == other.cell && edit == other.edit && revision == other.revision
+            && zoom == other.zoom && x == other.x && y == other.y;
+    }
+};
+
+struct TileKeyHash
+{
+    size_t operator()(const TileKey &key) const
+    {
+        size_t h = std::hash<const void *>()(key.cell);
+        h = h * 31 + size_t(key.edit);
+        h = h * 31 + key.revision;
+        h = h * 31 + size_t(key.zoom);
+        h = h * 1000003 + size_t(key.x);
+        h = h * 1000003 + size_t(key.y);
+        return h;
+    }
+};
+
+// Draws a cell from square tiles rasterized by a pool of threads.
+//
+// The tiles are cached by (cell, zoom level, tile index), so panning and
+// returning to a zoom level reuse them. They are stale once the styles of
+// the Techfile change, or the Structure::revision() of the cell does: that
+// is Structure::Add() or Del() on the cell or a cell under it, or changing
+// an element in place followed by Structure::Invalidate() on its structure.
+// A change in place without Invalidate() is not seen. A tile which is not
+// ready yet is left empty; it is scheduled and `ready` is called, from the
+// worker thread, once it is done.
+//
+// The workers read the elements without locking, so call quiesce() before
+// editing the cell or a cell under it.
+class TileRenderer
+{
+public:
+    TileRenderer(std::shared_ptr<Structure> cell, int threads = 0);
+    ~TileRenderer();
+
+    // Composite the tiles covering `rect`, in the coordinates of the cell,
+    // with the painter's current transform. The transform must not rotate.
+    void draw(QPainter &painter, const QRectF &rect);
+    // Drop every tile and forget the scheduled ones.
+    void clear();
+    // Cancel the queued tiles and wait for the running ones, so that the
+    // cells can be edited. The next draw() schedules the tiles again.
+    void quiesce();
+
+    void set_cell(std::shared_ptr<Structure> cell);
+    void set_render_options(const RenderOptions &options);
+    void set_level(int level);
+    void set_ready(std::function<void()> ready);
+    // Number of tiles kept, 256x256 pixels of 4 bytes each, i.e. 256 KiB.
+    // The default of 96 tiles, 24 MiB, holds a full HD view (at most 54
+    // tiles) and its surroundings.
+    void set_capacity(size_t tiles);
+
+    static const int kTileSize = 256;
+
+private:
+    typedef std::list<std::pair<TileKey, QImage> > TileList;
+    class Job;
+
+    void schedule(const TileKey &key, double scale);
+    // Evict the least recently used tiles beyond the capacity.
+    void trim();
+    void finish(const TileKey &key, unsigned long long generation, const QImage &image);
+
+    std::shared_ptr<Structure> cell_;
+    RenderOptions options_;
+    int level_;
+    std::function<void()> ready_;
+    size_t capacity_;
+
+    std::mutex mutex_;
+    // The tiles, most recently used first, and their index.
+    TileList lru_;
+    std::unordered_map<TileKey, TileList::iterator, TileKeyHash> tiles_;
+    std::unordered_set<TileKey, TileKeyHash> pending_;
+    // Bumped by clear(), so that tiles of an older setup are dropped.
+    unsigned long long generation_;
+    // Zoom level of the last draw; queued tiles of another level are dropped.
+    int zoom_;
+    // Revision of the cell at the last draw; tiles of another are dropped.
+    unsigned long long edit_;
+    QThreadPool pool_;
+};
+
+}
+#endif
@@ -0,0 +1,150 @@
+/*
+ * This file is part of GDSII.
+ *
+ * rtree.cpp -- The file which implements the spatial index of the
+ *              elements of a structure.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <algorithm>
+#include <cmath>
+#include "rtree.h"
+
+namespace GDS
+{
+
+RTree::RTree()
+{
+}
+
+void RTree::build(const std::vector<Box> &boxes, const std::vector<int> &items)
+{
+	Nodes.clear();
+	Items.clear();
+	Levels.clear();
+	size_t count = std::min(boxes.size(), items.size());
+	if (count == 0)
+		return;
+
+	// Twice the center, to stay in integers.
+	std::vector<size_t> order(count);
+	std::vector<long long> cx(count), cy(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		order[i] = i;
+		cx[i] = 2LL * boxes[i].x + boxes[i].w;
+		cy[i] = 2LL * boxes[i].y + boxes[i].h;
+	}
+
+	// Cut the boxes into vertical slices by center x, each holding about
+	// sqrt(leaves) leaves, then order every slice by center y.
+	size_t leaves = (count + Fanout - 1) / Fanout;
+	size_t slices = size_t(std::ceil(std::sqrt(double(leaves))));
+	size_t slice_size = slices * Fanout;
+	std::sort(order.begin(), order.end(),
+			  [&](size_t a, size_t b) { return cx[a] < cx[b]; });
+	for (size_t begin = 0; begin < count; begin += slice_size)
+	{
+		size_t end = std::min(begin + slice_size, count);
+		std::sort(order.begin() + begin, order.begin() + end,
+				  [&](size_t a, size_t b) { return cy[a] < cy[b]; });
+	}
+
+	Nodes.reserve(count + count / (Fanout - 1) + 1);
+	Items.reserve(count);
+	Levels.push_back(0);
+	for (size_t i : order)
+	{
+		const Box &b = boxes[i];
+		Nodes.push_back({ b.x, b.y, b.x + b.w, b.y + b.h });
+		Items.push_back(items[i]);
+	}
+
+	// Group consecutive entries of each level until one root is left.
+	size_t begin = 0;
+	size_t end = Nodes.size();
+	while (end - begin > 1)
+	{
+		Levels.push_back(end);
+		for (size_t i = begin; i < end; i += Fanout)
+		{
+			Node node = Nodes[i];
+			size_t last = std::min(i + Fanout, end);
+			for (size_t j = i + 1; j < last; j++)
+			{
+				node.llx = std::min(node.llx, Nodes[j].llx);
+				node.lly = std::min(node.lly, Nodes[j].lly);
+				node.urx = std::max(node.urx, Nodes[j].urx);
+				node.ury = std::max(node.ury, Nodes[j].ury);
+			}
+			Nodes.push_back(node);
+		}
+		begin = end;
+		end = Nodes.size();
+	}
+	Levels.push_back(end);
+}
+
+void RTree::query(const Box &window, std::vector<int> &items) const
+{
+	if (Nodes.empty())
+		return;
+	long long llx = window.x;
+	long long lly = window.y;
+	long long urx = llx + window.w;
+	long long ury = lly + window.h;
+	auto hit = [&](const Node &n) {
+		return n.llx <= urx && llx <= n.urx && n.lly <= ury && lly <= n.ury;
+	};
+
+	// Pairs of (level, index in level), starting from the root.
+	std::vector<std::pair<size_t, size_t> > stack;
+	size_t top = Levels.size() - 2;
+	if (!hit(Nodes[Levels[top]]))
+		return;
+	stack.emplace_back(top, 0);
+	while (!stack.empty())
+	{
+		size_t level = stack.back().first;
+		size_t index = stack.back().second;
+		stack.pop_back();
+		if (level == 0)
+		{
+			items.push_back(Items[index]);
+			continue;
+		}
+		size_t below = Levels[level - 1];
+		size_t first = index * Fanout;
+		size_t last = std::min(first + Fanout, Levels[level] - below);
+		for (size_t i = first; i < last; i++)
+		{
+			if (!hit(Nodes[below + i]))
+				continue;
+			if (level == 1)
+				items.push_back(Items[i]);
+			else
+				stack.emplace_back(level - 1, i);
+		}
+	}
+}
+
+size_t RTree::size() const
+{
+	return Items.size();
+}
+
+}
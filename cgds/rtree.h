@@ -0,0 +1,70 @@
+/*
+ * This file is part of GDSII.
+ *
+ * rtree.h -- The header file which declare the spatial index of the
+ *            elements of a structure.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef RTREE_H
+#define RTREE_H
+#include <vector>
+#include "tags.h"
+
+namespace GDS {
+
+/*!
+	* \brief Static R-tree packed by Sort-Tile-Recursive bulk loading.
+	*
+	* The tree is built once from all the boxes and cannot be modified; build
+	* it again after a change. Every level is stored in one flat array, the
+	* leaves first, and node k of a level covers the entries
+	* [k * Fanout, (k + 1) * Fanout) of the level below.
+	*/
+class RTree {
+	struct Node {
+		int llx, lly, urx, ury;
+	};
+
+	std::vector<Node>   Nodes;
+	std::vector<int>    Items;
+	// Start of each level in Nodes, followed by the end of the last level.
+	std::vector<size_t> Levels;
+
+public:
+	static const int Fanout = 16;
+
+	RTree();
+
+	/*!
+		* Replace the content of the tree.
+		*
+		* \param [in] boxes		The boxes to index.
+		* \param [in] items		The value returned by query() for each box.
+		*/
+	void build(const std::vector<Box> &boxes, const std::vector<int> &items);
+	/*!
+		* Append the items whose box intersects the window, in no particular
+		* order.
+		*/
+	void query(const Box &window, std::vector<int> &items) const;
+	size_t size() const;
+};
+
+}
+
+#endif // RTREE_H
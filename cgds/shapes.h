@@ -0,0 +1,79 @@
+/*
+ * This file is part of GDSII.
+ *
+ * shapes.h -- The header file which declare the flat storage of shapes.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SHAPES_H
+#define SHAPES_H
+#include <vector>
+#include "tags.h"
+
+namespace GDS {
+
+/*!
+	* \brief Boundaries and paths of one layer, stored as flat arrays.
+	*
+	* Shape i is a BOUNDARY or a PATH (tags[i]) with the vertices
+	* points[offsets[i]] .. points[offsets[i + 1] - 1]. widths[i] is the width
+	* of a path and 0 for a boundary.
+	*/
+struct ShapeArray
+{
+	short                     layer;
+	short                     datatype;
+	std::vector<Point>        points;
+	std::vector<size_t>       offsets;
+	std::vector<int>          widths;
+	std::vector<Record_type>  tags;
+
+	ShapeArray(short layer = 0, short datatype = 0)
+		: layer(layer), datatype(datatype), offsets(1, 0)
+	{
+	}
+
+	size_t size() const
+	{
+		return tags.size();
+	}
+
+	void clear()
+	{
+		points.clear();
+		offsets.assign(1, 0);
+		widths.clear();
+		tags.clear();
+	}
+
+	/*!
+		* Append a shape of count vertices and return its vertices to fill in.
+		*/
+	Point *add(Record_type tag, int width, size_t count)
+	{
+		size_t begin = points.size();
+		points.resize(begin + count);
+		offsets.push_back(begin + count);
+		widths.push_back(width);
+		tags.push_back(tag);
+		return points.data() + begin;
+	}
+};
+
+}
+
+#endif // SHAPES_H
@@ -0,0 +1,542 @@
+/*
+ * This file is part of GDSII.
+ *
+ * snapshot.cpp -- The source file which defines the native snapshot format
+ *                 used to reopen a library without parsing GDSII records.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+#include "library.h"
+#include "gdsio.h"
+#include "boundary.h"
+#include "path.h"
+#include "text.h"
+#include "sref.h"
+#include "aref.h"
+#include "arena.h"
+
+namespace GDS
+{
+
+/*
+ * Snapshot layout. Every section starts at an 8-byte aligned offset and all
+ * values are little-endian:
+ *
+ *  SnapshotHeader
+ *  SnapshotCell     [cell_count]
+ *  SnapshotElement  [element_count]
+ *  Point            [point_count]
+ *  char             [string_size]
+ *
+ * The elements of a cell, and the points of an element, are contiguous.
+ * Strings are referenced by offset and size into the string section.
+ **/
+static const char kSnapshotMagic[8] = { 'C', 'G', 'D', 'S', 'S', 'N', 'A', 'P' };
+static const uint32_t kSnapshotVersion = 1;
+
+struct SnapshotString
+{
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct SnapshotHeader
+{
+	char            magic[8];
+	uint32_t        version;
+	uint32_t        reserved;
+	uint64_t        source_size;
+	int64_t         source_mtime;
+	double          dbunit_in_meter;
+	double          dbunit_in_userunit;
+	int16_t         lib_version;
+	int16_t         dates[12];
+	int16_t         padding[3];
+	SnapshotString  lib_name;
+	uint64_t        cell_count;
+	uint64_t        cell_offset;
+	uint64_t        element_count;
+	uint64_t        element_offset;
+	uint64_t        point_count;
+	uint64_t        point_offset;
+	uint64_t        string_size;
+	uint64_t        string_offset;
+};
+
+struct SnapshotCell
+{
+	SnapshotString  name;
+	uint64_t        first_element;
+	uint64_t        element_count;
+	int16_t         dates[12];
+};
+
+struct SnapshotElement
+{
+	uint8_t         tag;
+	uint8_t         reserved;
+	int16_t         layer;
+	int16_t         type;           //< DATATYPE or TEXTTYPE
+	int16_t         strans;
+	int16_t         style;          //< PATHTYPE or PRESENTATION
+	int16_t         row;
+	int16_t         col;
+	int16_t         padding;
+	int32_t         width;
+	SnapshotString  string;         //< SNAME or STRING
+	double          angle;
+	double          mag;
+	uint64_t        first_point;
+	uint64_t        point_count;
+};
+
+static_assert(sizeof(Point) == 8, "Point must be two packed 32-bit integers");
+static_assert(sizeof(SnapshotHeader) % 8 == 0, "misaligned SnapshotHeader");
+static_assert(sizeof(SnapshotCell) % 8 == 0, "misaligned SnapshotCell");
+static_assert(sizeof(SnapshotElement) % 8 == 0, "misaligned SnapshotElement");
+
+static bool LittleEndianHost()
+{
+	uint16_t probe = 1;
+	return *(const uint8_t *)&probe == 1;
+}
+
+static bool SourceStamp(const std::string &file_name, uint64_t &size, int64_t &mtime)
+{
+	std::error_code ec;
+	size = std::filesystem::file_size(file_name, ec);
+	if (ec)
+		return false;
+	auto time = std::filesystem::last_write_time(file_name, ec);
+	if (ec)
+		return false;
+	mtime = int64_t(time.time_since_epoch().count());
+	return true;
+}
+
+static SnapshotString AddString(std::vector<char> &pool, const std::string &data)
+{
+	SnapshotString ret;
+	ret.offset = uint32_t(pool.size());
+	ret.size = uint32_t(data.size());
+	pool.insert(pool.end(), data.begin(), data.end());
+	return ret;
+}
+
+/*
+ * Store each referenced structure name once.
+ */
+static SnapshotString AddName(std::vector<char> &pool, std::unordered_map<std::string_view, SnapshotString> &names,
+							  const std::string &name)
+{
+	auto iter = names.find(name);
+	if (iter == names.end())
+		iter = names.emplace(name, AddString(pool, name)).first;
+	return iter->second;
+}
+
+/*
+ * Look up a string of the pool, false if it does not lie inside the pool.
+ */
+static bool GetString(const char *pool, uint64_t pool_size, SnapshotString data, std::string_view &ret)
+{
+	if (data.offset > pool_size || data.size > pool_size - data.offset)
+		return false;
+	ret = std::string_view(pool + data.offset, data.size);
+	return true;
+}
+
+/*
+ * Map count items of item_size bytes at offset, null if they do not lie
+ * inside the snapshot.
+ */
+static const void *GetSection(const Reader &snapshot, uint64_t offset, uint64_t count, uint64_t item_size)
+{
+	const uint64_t limit = std::numeric_limits<size_t>::max();
+	if (count > limit / item_size)
+		return nullptr;
+	uint64_t size = count * item_size;
+	if (offset > limit - size)
+		return nullptr;
+	return snapshot.range(size_t(offset), size_t(offset + size)).fetch(size_t(size));
+}
+
+/*
+ * True if [first, first + count) lies inside [0, total).
+ */
+static bool InRange(uint64_t first, uint64_t count, uint64_t total)
+{
+	return first <= total && count <= total - first;
+}
+
+static uint64_t Align(uint64_t offset)
+{
+	return (offset + 7) & ~uint64_t(7);
+}
+
+int Library::write_snapshot(const std::string &file_name, const std::string &source_name, std::string &msg)
+{
+	msg = "";
+	if (!LittleEndianHost())
+	{
+		msg = "Snapshots are only supported on little-endian hosts.";
+		return FILE_ERROR;
+	}
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+	header.version = kSnapshotVersion;
+	if (!SourceStamp(source_name, header.source_size, header.source_mtime))
+	{
+		msg = "Can not stat " + source_name + ".";
+		return FILE_ERROR;
+	}
+	header.dbunit_in_meter = DBUnit_in_meter;
+	header.dbunit_in_userunit = DBUnit_in_userunit;
+	header.lib_version = Version;
+	short dates[12] = { Mod_year, Mod_month, Mod_day, Mod_hour, Mod_minute, Mod_second,
+		Acc_year, Acc_month, Acc_day, Acc_hour, Acc_minute, Acc_second };
+	memcpy(header.dates, dates, sizeof(header.dates));
+
+	std::vector<SnapshotCell> cells;
+	std::vector<SnapshotElement> elements;
+	std::vector<Point> points;
+	std::vector<char> strings;
+	// The keys view the interned names, which outlive the map.
+	std::unordered_map<std::string_view, SnapshotString> names;
+	header.lib_name = AddString(strings, Lib_name);
+
+	for (auto cell : Cells)
+	{
+		int error_code = cell->load(msg);
+		if (error_code > 0)
+			return error_code;
+
+		SnapshotCell c;
+		memset(&c, 0, sizeof(c));
+		c.name = AddString(strings, cell->name());
+		c.first_element = elements.size();
+		c.element_count = cell->Elements.size();
+		short cell_dates[12] = { cell->Mod_year, cell->Mod_month, cell->Mod_day,
+			cell->Mod_hour, cell->Mod_minute, cell->Mod_second,
+			cell->Acc_year, cell->Acc_month, cell->Acc_day,
+			cell->Acc_hour, cell->Acc_minute, cell->Acc_second };
+		memcpy(c.dates, cell_dates, sizeof(c.dates));
+		cells.push_back(c);
+
+		for (auto node : cell->Elements)
+		{
+			SnapshotElement e;
+			memset(&e, 0, sizeof(e));
+			e.tag = node->tag();
+			e.mag = 1;
+			PointView pts;
+			Point single;
+			switch (node->tag())
+			{
+			case BOUNDARY:
+			{
+				auto boundary = std::dynamic_pointer_cast<Boundary>(node);
+				e.layer = boundary->layer();
+				e.type = boundary->data_type();
+				pts = boundary->points();
+				break;
+			}
+			case PATH:
+			{
+				auto path = std::dynamic_pointer_cast<Path>(node);
+				e.layer = path->layer();
+				e.type = path->data_type();
+				e.width = path->width();
+				e.style = path->path_type();
+				pts = path->points();
+				break;
+			}
+			case TEXT:
+			{
+				auto text = std::dynamic_pointer_cast<Text>(node);
+				e.layer = text->layer();
+				e.type = text->text_type();
+				e.style = text->presentation();
+				e.strans = text->strans();
+				e.string = AddString(strings, text->string());
+				single = text->xy();
+				pts = PointView(&single, 1);
+				break;
+			}
+			case SREF:
+			{
+				auto sref = std::dynamic_pointer_cast<SRef>(node);
+				e.strans = sref->strans();
+				e.angle = sref->angle();
+				e.mag = sref->mag();
+				e.string = AddName(strings, names, sref->structName());
+				single = sref->xy();
+				pts = PointView(&single, 1);
+				break;
+			}
+			case AREF:
+			{
+				auto aref = std::dynamic_pointer_cast<ARef>(node);
+				e.strans = aref->strans();
+				e.angle = aref->angle();
+				e.mag = aref->mag();
+				e.row = aref->row();
+				e.col = aref->col();
+				e.string = AddName(strings, names, aref->structName());
+				pts = aref->points();
+				break;
+			}
+			default:
+				break;
+			}
+			e.first_point = points.size();
+			e.point_count = pts.size();
+			points.insert(points.end(), pts.begin(), pts.end());
+			elements.push_back(e);
+		}
+	}
+	if (strings.size() > std::numeric_limits<uint32_t>::max())
+	{
+		msg = "Too many names for a snapshot.";
+		return FORMAT_ERROR;
+	}
+
+	header.cell_count = cells.size();
+	header.cell_offset = sizeof(SnapshotHeader);
+	header.element_count = elements.size();
+	header.element_offset = Align(header.cell_offset + cells.size() * sizeof(SnapshotCell));
+	header.point_count = points.size();
+	header.point_offset = Align(header.element_offset + elements.size() * sizeof(SnapshotElement));
+	header.string_size = strings.size();
+	header.string_offset = Align(header.point_offset + points.size() * sizeof(Point));
+
+	std::ofstream out(file_name, std::ofstream::binary);
+	if (!out.is_open())
+	{
+		msg = "Can not open " + file_name + ".";
+		return FILE_ERROR;
+	}
+	const char zeros[8] = { 0 };
+	auto pad = [&out, &zeros](uint64_t offset)
+	{
+		out.write(zeros, std::streamsize(offset - uint64_t(out.tellp())));
+	};
+	out.write((const char *)&header, sizeof(header));
+	out.write((const char *)cells.data(), cells.size() * sizeof(SnapshotCell));
+	pad(header.element_offset);
+	out.write((const char *)elements.data(), elements.size() * sizeof(SnapshotElement));
+	pad(header.point_offset);
+	out.write((const char *)points.data(), points.size() * sizeof(Point));
+	pad(header.string_offset);
+	out.write(strings.data(), strings.size());
+
+	return out.fail() ? FILE_ERROR : 0;
+}
+
+int Library::open_snapshot(const std::string &file_name, const std::string &source_name, std::string &msg)
+{
+	msg = "";
+	init();
+	if (!LittleEndianHost())
+	{
+		msg = "Snapshots are only supported on little-endian hosts.";
+		return FILE_ERROR;
+	}
+
+	Reader snapshot;
+	if (!snapshot.open(file_name))
+	{
+		msg = "Can not map " + file_name + ".";
+		return FILE_ERROR;
+	}
+	const SnapshotHeader *header = (const SnapshotHeader *)snapshot.range(0, sizeof(SnapshotHeader)).fetch(sizeof(SnapshotHeader));
+	if (header == nullptr
+		|| memcmp(header->magic, kSnapshotMagic, sizeof(header->magic)) != 0
+		|| header->version != kSnapshotVersion)
+	{
+		msg = file_name + " is not a snapshot of this version.";
+		return FORMAT_ERROR;
+	}
+	uint64_t source_size;
+	int64_t source_mtime;
+	if (!SourceStamp(source_name, source_size, source_mtime)
+		|| source_size != header->source_size
+		|| source_mtime != header->source_mtime)
+	{
+		msg = file_name + " is out of date with " + source_name + ".";
+		return FILE_ERROR;
+	}
+
+	// Every section must lie inside the file.
+	const SnapshotCell *cells = (const SnapshotCell *)GetSection(snapshot,
+		header->cell_offset, header->cell_count, sizeof(SnapshotCell));
+	const SnapshotElement *elements = (const SnapshotElement *)GetSection(snapshot,
+		header->element_offset, header->element_count, sizeof(SnapshotElement));
+	const Point *points = (const Point *)GetSection(snapshot,
+		header->point_offset, header->point_count, sizeof(Point));
+	const char *strings = (const char *)GetSection(snapshot,
+		header->string_offset, header->string_size, 1);
+	if ((header->cell_count > 0 && cells == nullptr)
+		|| (header->element_count > 0 && elements == nullptr)
+		|| (header->point_count > 0 && points == nullptr)
+		|| (header->string_size > 0 && strings == nullptr))
+	{
+		msg = file_name + " is truncated.";
+		return FORMAT_ERROR;
+	}
+	uint64_t string_size = header->string_size;
+	std::string_view lib_name;
+	if (!GetString(strings, string_size, header->lib_name, lib_name))
+	{
+		msg = file_name + " is corrupted.";
+		return FORMAT_ERROR;
+	}
+
+	Version = header->lib_version;
+	short *dates[12] = { &Mod_year, &Mod_month, &Mod_day, &Mod_hour, &Mod_minute, &Mod_second,
+		&Acc_year, &Acc_month, &Acc_day, &Acc_hour, &Acc_minute, &Acc_second };
+	for (int i = 0; i < 12; i++)
+		*dates[i] = header->dates[i];
+	DBUnit_in_meter = header->dbunit_in_meter;
+	DBUnit_in_userunit = header->dbunit_in_userunit;
+	Lib_name = std::string(lib_name);
+
+	std::shared_ptr<Arena> arena = Use_arena ? std::make_shared<Arena>() : nullptr;
+	std::weak_ptr<Library *> owner = Self;
+	for (uint64_t i = 0; i < header->cell_count; i++)
+	{
+		const SnapshotCell &c = cells[i];
+		std::string_view name;
+		if (!GetString(strings, string_size, c.name, name)
+			|| !InRange(c.first_element, c.element_count, header->element_count))
+		{
+			msg = file_name + " is corrupted.";
+			return FORMAT_ERROR;
+		}
+		std::shared_ptr<Structure> node = std::make_shared<Structure>(Names, Names->intern(name));
+		node->set_arena(arena);
+		short *cell_dates[12] = { &node->Mod_year, &node->Mod_month, &node->Mod_day,
+			&node->Mod_hour, &node->Mod_minute, &node->Mod_second,
+			&node->Acc_year, &node->Acc_month, &node->Acc_day,
+			&node->Acc_hour, &node->Acc_minute, &node->Acc_second };
+		for (int j = 0; j < 12; j++)
+			*cell_dates[j] = c.dates[j];
+
+		// The loader keeps the mapping alive through its reader, and the
+		// names through the structure.
+		node->set_loader([owner, snapshot, elements, points, strings, string_size, c, header](Structure &cell, std::string &cell_msg) -> int
+		{
+			NameCache names(cell.names());
+			cell.Elements.reserve(c.element_count);
+			for (uint64_t k = c.first_element; k < c.first_element + c.element_count; k++)
+			{
+				const SnapshotElement &e = elements[k];
+				std::string_view string;
+				if (!InRange(e.first_point, e.point_count, header->point_count)
+					|| ((e.tag == TEXT || e.tag == SREF || e.tag == AREF)
+						&& !GetString(strings, string_size, e.string, string)))
+				{
+					cell_msg = "Snapshot of " + cell.name() + " is corrupted.";
+					return FORMAT_ERROR;
+				}
+				// Built where the element keeps its points, so set_xy() takes them over.
+				PointArray pts(points + e.first_point, points + e.first_point + e.point_count,
+							   cell.arena() ? cell.arena().get() : std::pmr::get_default_resource());
+				switch (e.tag)
+				{
+				case BOUNDARY:
+				{
+					std::shared_ptr<Boundary> boundary = MakeElement<Boundary>(cell.arena().get());
+					boundary->set_layer(e.layer);
+					boundary->set_data_type(e.type);
+					boundary->set_xy(std::move(pts));
+					cell.Elements.push_back(boundary);
+					break;
+				}
+				case PATH:
+				{
+					std::shared_ptr<Path> path = MakeElement<Path>(cell.arena().get());
+					path->set_layer(e.layer);
+					path->set_data_type(e.type);
+					path->set_width(e.width);
+					path->set_path_type(e.style);
+					path->set_xy(std::move(pts));
+					cell.Elements.push_back(path);
+					break;
+				}
+				case TEXT:
+				{
+					std::shared_ptr<Text> text = MakeElement<Text>(cell.arena().get());
+					text->set_layer(e.layer);
+					text->set_text_type(e.type);
+					text->set_presentation(e.style);
+					text->set_strans(e.strans);
+					text->set_string(std::string(string));
+					if (!pts.empty())
+						text->set_xy(pts[0]);
+					cell.Elements.push_back(text);
+					break;
+				}
+				case SREF:
+				{
+					std::shared_ptr<SRef> sref = MakeElement<SRef>(cell.arena().get());
+					sref->set_struct_id(names.table().get(), names.intern(string));
+					sref->set_strans(e.strans);
+					sref->set_angle(e.angle);
+					sref->set_mag(e.mag);
+					if (!pts.empty())
+						sref->set_xy(pts[0]);
+					cell.Elements.push_back(sref);
+					break;
+				}
+				case AREF:
+				{
+					std::shared_ptr<ARef> aref = MakeElement<ARef>(cell.arena().get());
+					aref->set_struct_id(names.table().get(), names.intern(string));
+					aref->set_strans(e.strans);
+					aref->set_angle(e.angle);
+					aref->set_mag(e.mag);
+					aref->set_row_col(e.row, e.col);
+					aref->set_xy(std::move(pts));
+					cell.Elements.push_back(aref);
+					break;
+				}
+				default:
+					break;
+				}
+			}
+			if (auto library = owner.lock())
+				(*library)->LinkCell(cell);
+			return 0;
+		});
+		Cells.push_back(node);
+	}
+	IndexCells();
+
+	return 0;
+}
+
+}
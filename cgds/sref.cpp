@@ -20,11 +20,11 @@
  **/
 
 #include <assert.h>
-#include <QtGui/QTransform>
 #include "sref.h"
 #include <sstream>
 #include "gdsio.h"
 #include "structures.h"
+#include "transform.h"
 
 namespace GDS
 {
@@ -32,7 +32,8 @@ namespace GDS
 SRef::SRef() :Element(SREF)
 {
 	Eflags = 0;
-	SName = "";
+	Names = NameTable::detached().get();
+	SName = 0;
 	Strans = 0;
 	Angle = 0;
 	Mag = 1;
@@ -43,11 +44,21 @@ SRef::~SRef()
 {
 }
 
-std::string SRef::structName() const
+const std::string &SRef::structName() const
+{
+	return Names->name(SName);
+}
+
+NameId SRef::structId() const
 {
 	return SName;
 }
 
+NameTable *SRef::names() const
+{
+	return Names;
+}
+
 Point SRef::xy() const
 {
 	return Pt;
@@ -73,9 +84,15 @@ bool SRef::stransFlag(STRANS_FLAG flag) const
 	return Strans & flag;
 }
 
-void SRef::set_struct_name(std::string name)
+void SRef::set_struct_name(std::string_view name)
+{
+	SName = Names->intern(name);
+}
+
+void SRef::set_struct_id(NameTable *names, NameId id)
 {
-	SName = name;
+	Names = names;
+	SName = id;
 }
 
 void SRef::set_xy(Point pt)
@@ -116,23 +133,16 @@ bool SRef::bbox(int &x, int &y, int &w, int &h) const
     std::shared_ptr<Structure> ref_cell = ReferTo.lock();
     if (!ref_cell->bbox(ref_x, ref_y, ref_w, ref_h))
         return false;
-    QTransform reflect_transform, mag_transform, rotate_transform, shift_transform;
-    if (stransFlag(REFLECTION))
-        reflect_transform.scale(1, -1);
-    mag_transform.scale(mag(), mag());
-    rotate_transform.rotate(angle());
-    shift_transform.translate(Pt.x, Pt.y);
-    QTransform transform = reflect_transform * mag_transform * rotate_transform * shift_transform;
-    QRect rect(ref_x, ref_y, ref_w, ref_h);
-    QRect rect2 = transform.mapRect(rect);
-    x = rect2.x();
-    y = rect2.y();
-    w = rect2.width();
-    h = rect2.height();
+    Transform transform(Pt, mag(), angle(), stransFlag(REFLECTION));
+    transform.mapBox(ref_x, ref_y, ref_w, ref_h);
+    x = ref_x;
+    y = ref_y;
+    w = ref_w;
+    h = ref_h;
 	return true;
 }
 
-int SRef::read(std::ifstream &in, std::string &msg)
+int SRef::read(Reader &in, std::string &msg)
 {
 	msg = "";
 	bool finished = false;
@@ -172,8 +182,9 @@ int SRef::read(std::ifstream &in, std::string &msg)
 				msg = ss.str();
 				return FORMAT_ERROR;
 			}
-			if (!readString(in, record_size - 4, SName))
+			if (!readName(in, record_size - 4, SName))
 				return FILE_ERROR;
+			Names = in.name_table().get();
 			break;
 		case XY:
 			if (record_size != 12)
@@ -237,7 +248,7 @@ int SRef::read(std::ifstream &in, std::string &msg)
 	return 0;
 }
 
-int SRef::write(std::ofstream &out, std::string &msg)
+int SRef::write(Writer &out, std::string &msg)
 {
 	short record_size;
 
@@ -258,13 +269,14 @@ int SRef::write(std::ofstream &out, std::string &msg)
 	writeByte(out, Integer_2);
 	writeShort(out, Strans);
 
-    record_size = 4 + short(SName.size());
+	const std::string &sname = Names->name(SName);
+    record_size = 4 + short(sname.size());
 	if (record_size % 2 != 0)
 		record_size += 1;
 	writeShort(out, record_size);
 	writeByte(out, SNAME);
 	writeByte(out, String);
-	writeString(out, SName);
+	writeString(out, sname);
 
 	record_size = 12;
 	writeShort(out, record_size);
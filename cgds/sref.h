@@ -23,6 +23,7 @@
 #define SREF_H
 #include <memory>
 #include "elements.h"
+#include "names.h"
 
 namespace GDS {
 class Structure;
@@ -40,7 +41,8 @@ class Structure;
 	*/
 class SRef : public Element {
 	short               Eflags;
-	std::string         SName;
+	NameTable          *Names;
+	NameId              SName;
 	short               Strans;
 	Point               Pt;
 	double              Angle;
@@ -51,7 +53,13 @@ public:
 	SRef();
 	virtual ~SRef();
 
-	std::string structName() const;
+	const std::string &structName() const;
+	/*!
+		* The interned name of the referenced structure, an index into
+		* names().
+		*/
+	NameId structId() const;
+	NameTable *names() const;
 	Point xy() const;
 	double angle() const;
 	double mag() const;
@@ -60,7 +68,16 @@ public:
 	virtual bool bbox(int &x, int &y, int &w, int &h) const;
     std::shared_ptr<Structure> reference() { return ReferTo.lock(); }
 
-    void set_struct_name(std::string name);
+	/*!
+		* Refer to a structure by name. The name is interned in the table
+		* of the reference, or in NameTable::detached() for a new one.
+		*/
+    void set_struct_name(std::string_view name);
+	/*!
+		* Refer to a structure by interned name. The table must outlive the
+		* reference, e.g. the table of the library holding it.
+		*/
+	void set_struct_id(NameTable *names, NameId id);
     void set_xy(Point pt);
     void set_angle(double angle);
     void set_mag(double mag);
@@ -68,8 +85,8 @@ public:
     void set_strans(STRANS_FLAG flag, bool enable = true);
     void set_reference(std::shared_ptr<Structure> ref);
 
-	virtual int read(std::ifstream &in, std::string &msg);
-	virtual int write(std::ofstream &out, std::string &msg);
+	virtual int read(Reader &in, std::string &msg);
+	virtual int write(Writer &out, std::string &msg);
 };
 
 }
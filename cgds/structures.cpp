@@ -23,6 +23,8 @@
 #include <limits>
 #include <algorithm>
 #include <sstream>
+#include <map>
+#include <unordered_set>
 #include "structures.h"
 #include "boundary.h"
 #include "path.h"
@@ -30,6 +32,8 @@
 #include "aref.h"
 #include "gdsio.h"
 #include "text.h"
+#include "rtree.h"
+#include "arena.h"
 //#include "node.h"
 #include <ctime>
 
@@ -37,9 +41,9 @@ namespace GDS
 {
 
 Structure::Structure()
+	: Names(NameTable::detached()), Struct_name(0), Pending(false), Load_error(0),
+	BBox_valid(false), BBox_found(false), Revision(0)
 {
-	Struct_name = "";
-
 	time_t now = time(0);
 	tm *ltm = localtime(&now);
 	Mod_year = ltm->tm_year + 1900;
@@ -56,9 +60,15 @@ Structure::Structure()
 	Acc_second = ltm->tm_sec + 1;
 }
 
-Structure::Structure(std::string name)
+Structure::Structure(std::string_view name)
+	: Structure(NameTable::detached(), NameTable::detached()->intern(name))
+{
+}
+
+Structure::Structure(std::shared_ptr<NameTable> names, NameId name)
+	: Names(std::move(names)), Struct_name(name), Pending(false), Load_error(0),
+	BBox_valid(false), BBox_found(false), Revision(0)
 {
-	Struct_name = name;
 
 	time_t now = time(0);
 	tm *ltm = localtime(&now);
@@ -81,28 +91,47 @@ Structure::~Structure()
 	Elements.clear();
 }
 
-std::string Structure::name() const
+const std::string &Structure::name() const
+{
+	return Names->name(Struct_name);
+}
+
+NameId Structure::nameId() const
 {
 	return Struct_name;
 }
 
+const std::shared_ptr<NameTable> &Structure::names() const
+{
+	return Names;
+}
+
 size_t Structure::size() const
 {
+	ensureLoaded();
 	return Elements.size();
 }
 
 std::shared_ptr<Element> Structure::get(int index) const
 {
+	ensureLoaded();
 	if (index < 0 || index >= Elements.size())
 		return std::shared_ptr<Element>();
 	else
 		return Elements[index];
 }
 
+const std::vector<std::shared_ptr<Element> > &Structure::elements() const
+{
+	ensureLoaded();
+	return Elements;
+}
+
 void Structure::Add(std::shared_ptr<Element> new_element)
 {
 	if (new_element.get() == nullptr)
 		return;
+	ensureLoaded();
 	bool existed = false;
 	for (auto e : Elements)
 	{
@@ -113,8 +142,33 @@ void Structure::Add(std::shared_ptr<Element> new_element)
 		}
 	}
 	if (!existed)
+	{
+		// References are matched by index within the table of the library.
+		if (new_element->tag() == SREF)
+		{
+			auto sref = std::static_pointer_cast<SRef>(new_element);
+			if (sref->names() != Names.get())
+				sref->set_struct_id(Names.get(), Names->intern(sref->structName()));
+		}
+		else if (new_element->tag() == AREF)
+		{
+			auto aref = std::static_pointer_cast<ARef>(new_element);
+			if (aref->names() != Names.get())
+				aref->set_struct_id(Names.get(), Names->intern(aref->structName()));
+		}
 		Elements.push_back(new_element);
-			
+		Invalidate();
+	}
+}
+
+void Structure::Del(const std::shared_ptr<Element> &element)
+{
+	ensureLoaded();
+	auto iter = std::find(Elements.begin(), Elements.end(), element);
+	if (iter == Elements.end())
+		return;
+	Elements.erase(iter);
+	Invalidate();
 }
 
 void Structure::AddReferBy(std::shared_ptr<Structure> cell)
@@ -125,7 +179,7 @@ void Structure::AddReferBy(std::shared_ptr<Structure> cell)
 		auto node = tmp.lock();
 		if (!node)
 			continue;
-		if (node->name() == cell->name())
+		if (node->Names == cell->Names && node->Struct_name == cell->Struct_name)
 		{
 			existed = true;
 			break;
@@ -135,8 +189,143 @@ void Structure::AddReferBy(std::shared_ptr<Structure> cell)
 		ReferBy.push_back(cell);
 }
 
+void Structure::set_loader(std::function<int(Structure &, std::string &)> loader)
+{
+	std::lock_guard<std::recursive_mutex> lock(Load_mutex);
+	Loader = loader;
+	Pending.store(bool(Loader), std::memory_order_release);
+}
+
+int Structure::load(std::string &msg)
+{
+	if (!Pending.load(std::memory_order_acquire))
+	{
+		if (Load_error > 0)
+			msg = Load_msg;
+		return Load_error;
+	}
+	std::lock_guard<std::recursive_mutex> lock(Load_mutex);
+	// Empty when another thread has finished loading, or when the loader
+	// itself accesses the elements.
+	if (!Loader)
+	{
+		if (Load_error > 0)
+			msg = Load_msg;
+		return Load_error;
+	}
+	auto loader = std::move(Loader);
+	Loader = nullptr;
+	int error_code = loader(*this, msg);
+	if (error_code > 0)
+	{
+		Elements.clear();
+		Load_error = error_code;
+		Load_msg = msg;
+	}
+	Pending.store(false, std::memory_order_release);
+	return error_code;
+}
+
+void Structure::set_arena(std::shared_ptr<Arena> arena)
+{
+	if (Storage && Storage != arena && !Elements.empty())
+		Retired.push_back(Storage);
+	Storage = std::move(arena);
+}
+
+const std::shared_ptr<Arena> &Structure::arena() const
+{
+	return Storage;
+}
+
+bool Structure::loaded() const
+{
+	return !Pending.load(std::memory_order_acquire);
+}
+
+void Structure::Invalidate()
+{
+	{
+		std::lock_guard<std::mutex> lock(Layers_mutex);
+		Layers.reset();
+	}
+	BumpRevision();
+	InvalidateBounds();
+}
+
+unsigned long long Structure::revision() const
+{
+	return Revision.load(std::memory_order_acquire);
+}
+
+void Structure::BumpRevision()
+{
+	// Unlike the bounds, a revision is never clean, so every structure
+	// above has to be visited; each only once, as they may be shared.
+	Revision.fetch_add(1, std::memory_order_acq_rel);
+	if (ReferBy.empty())
+		return;
+	std::unordered_set<const Structure *> visited;
+	std::vector<std::shared_ptr<Structure> > stack;
+	std::shared_ptr<Structure> current;
+	visited.insert(this);
+	const Structure *node = this;
+	while (true)
+	{
+		for (auto tmp : node->ReferBy)
+		{
+			auto parent = tmp.lock();
+			if (parent && visited.insert(parent.get()).second)
+			{
+				parent->Revision.fetch_add(1, std::memory_order_acq_rel);
+				stack.push_back(parent);
+			}
+		}
+		if (stack.empty())
+			break;
+		current = stack.back();
+		stack.pop_back();
+		node = current.get();
+	}
+}
+
+void Structure::InvalidateBounds()
+{
+	bool dirty;
+	{
+		std::lock_guard<std::mutex> lock(BBox_mutex);
+		dirty = !BBox_valid;
+		BBox_valid = false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(Index_mutex);
+		dirty = dirty && !Index;
+		Index.reset();
+	}
+	// A dirty structure has only dirty referrers, so stop here.
+	if (dirty)
+		return;
+	for (auto tmp : ReferBy)
+	{
+		auto node = tmp.lock();
+		if (node)
+			node->InvalidateBounds();
+	}
+}
+
 bool Structure::bbox(int &x, int &y, int &w, int &h) const
 {
+	ensureLoaded();
+	std::lock_guard<std::mutex> lock(BBox_mutex);
+	if (BBox_valid)
+	{
+		x = BBox_x;
+		y = BBox_y;
+		w = BBox_w;
+		h = BBox_h;
+		return BBox_found;
+	}
+
 	int llx = GDS_MAX_INT;
 	int lly = GDS_MAX_INT;
 	int urx = GDS_MIN_INT;
@@ -159,10 +348,175 @@ bool Structure::bbox(int &x, int &y, int &w, int &h) const
 	w = urx - llx;
 	h = ury - lly;
 
+	BBox_x = x;
+	BBox_y = y;
+	BBox_w = w;
+	BBox_h = h;
+	BBox_found = ret;
+	BBox_valid = true;
+
 	return ret;
 }
 
-int Structure::read(std::ifstream &in, std::string &msg)
+void Structure::query(const Box &window, std::vector<int> &indices) const
+{
+	ensureLoaded();
+	indices.clear();
+	std::shared_ptr<const RTree> index;
+	{
+		std::lock_guard<std::mutex> lock(Index_mutex);
+		if (!Index)
+		{
+			std::vector<Box> boxes;
+			std::vector<int> items;
+			boxes.reserve(Elements.size());
+			items.reserve(Elements.size());
+			for (size_t i = 0; i < Elements.size(); i++)
+			{
+				Box b;
+				if (Elements[i]->bbox(b.x, b.y, b.w, b.h))
+				{
+					boxes.push_back(b);
+					items.push_back(int(i));
+				}
+			}
+			auto tree = std::make_shared<RTree>();
+			tree->build(boxes, items);
+			Index = tree;
+		}
+		index = Index;
+	}
+	index->query(window, indices);
+	std::sort(indices.begin(), indices.end());
+}
+
+void Structure::query(const Box &window, const ShapeVisitor &visitor,
+					  const Transform &transform) const
+{
+	Box local = window;
+	transform.inverted().mapBox(local.x, local.y, local.w, local.h);
+	std::vector<int> indices;
+	query(local, indices);
+
+	for (int i : indices)
+	{
+		const std::shared_ptr<Element> &node = Elements[i];
+		switch (node->tag())
+		{
+		case SREF:
+		{
+			auto sref = std::static_pointer_cast<SRef>(node);
+			auto cell = sref->reference();
+			if (!cell)
+				break;
+			Transform placement(sref->xy(), sref->mag(), sref->angle(),
+								sref->stransFlag(REFLECTION));
+			cell->query(window, visitor, transform * placement);
+			break;
+		}
+		case AREF:
+		{
+			auto aref = std::static_pointer_cast<ARef>(node);
+			auto cell = aref->reference();
+			Box cell_box;
+			if (!cell || !cell->bbox(cell_box.x, cell_box.y, cell_box.w, cell_box.h))
+				break;
+			PointView pts = aref->points();
+			int rows = aref->row();
+			int cols = aref->col();
+			if (pts.size() != 3 || rows <= 0 || cols <= 0)
+				break;
+			int row_pitch_x = (pts[2].x - pts[0].x) / rows;
+			int row_pitch_y = (pts[2].y - pts[0].y) / rows;
+			int col_pitch_x = (pts[1].x - pts[0].x) / cols;
+			int col_pitch_y = (pts[1].y - pts[0].y) / cols;
+			Transform placement(Point(0, 0), aref->mag(), aref->angle(),
+								aref->stransFlag(REFLECTION));
+			// The box of the instance at the origin of the lattice.
+			Box b = cell_box;
+			placement.mapBox(b.x, b.y, b.w, b.h);
+			int row_first, row_last, col_first, col_last;
+			bool axis_aligned = aref->placement_range(local, b, row_first, row_last,
+													  col_first, col_last);
+			b.x += pts[0].x;
+			b.y += pts[0].y;
+
+			for (int r = row_first; r <= row_last; r++)
+			{
+				for (int c = col_first; c <= col_last; c++)
+				{
+					int dx = r * row_pitch_x + c * col_pitch_x;
+					int dy = r * row_pitch_y + c * col_pitch_y;
+					if (!axis_aligned && !Box(b.x + dx, b.y + dy, b.w, b.h).intersects(local))
+						continue;
+					cell->query(window, visitor,
+								transform * placement.translated(pts[0].x + dx, pts[0].y + dy));
+				}
+			}
+			break;
+		}
+		default:
+			if (!transform.manhattan())
+			{
+				Box shape;
+				node->bbox(shape.x, shape.y, shape.w, shape.h);
+				transform.mapBox(shape.x, shape.y, shape.w, shape.h);
+				if (!shape.intersects(window))
+					break;
+			}
+			visitor(node, transform);
+			break;
+		}
+	}
+}
+
+std::shared_ptr<const std::vector<ShapeArray> > Structure::layers() const
+{
+	ensureLoaded();
+	std::lock_guard<std::mutex> lock(Layers_mutex);
+	if (Layers)
+		return Layers;
+
+	std::map<std::pair<short, short>, ShapeArray> buckets;
+	auto bucket = [&](short layer, short datatype) -> ShapeArray &
+	{
+		auto key = std::make_pair(layer, datatype);
+		auto iter = buckets.find(key);
+		if (iter == buckets.end())
+			iter = buckets.emplace(key, ShapeArray(layer, datatype)).first;
+		return iter->second;
+	};
+	for (auto &node : Elements)
+	{
+		if (node->tag() == BOUNDARY)
+		{
+			auto b = static_cast<Boundary *>(node.get());
+			PointView pts = b->points();
+			ShapeArray &shapes = bucket(b->layer(), b->data_type());
+			std::copy(pts.begin(), pts.end(), shapes.add(BOUNDARY, 0, pts.size()));
+		}
+		else if (node->tag() == PATH)
+		{
+			auto p = static_cast<Path *>(node.get());
+			PointView pts = p->points();
+			ShapeArray &shapes = bucket(p->layer(), p->data_type());
+			std::copy(pts.begin(), pts.end(), shapes.add(PATH, p->width(), pts.size()));
+		}
+	}
+
+	auto layers = std::make_shared<std::vector<ShapeArray> >();
+	layers->reserve(buckets.size());
+	for (auto &item : buckets)
+	{
+		ShapeArray &shapes = item.second;
+		shapes.points.shrink_to_fit();
+		layers->push_back(std::move(shapes));
+	}
+	Layers = layers;
+	return Layers;
+}
+
+int Structure::read(Reader &in, std::string &msg)
 {
 	if (!readShort(in, Mod_year)
 		|| !readShort(in, Mod_month)
@@ -202,6 +556,7 @@ int Structure::read(std::ifstream &in, std::string &msg)
 			finished = true;
 			break;
 		case STRNAME:
+		{
 			if (record_size < 4 || record_size % 2 != 0)
 			{
 				std::stringstream ss;
@@ -211,9 +566,17 @@ int Structure::read(std::ifstream &in, std::string &msg)
 				msg = ss.str();
 				return FORMAT_ERROR;
 			}
-			if (!readString(in, record_size - 4, Struct_name))
+			NameId id;
+			if (!readName(in, record_size - 4, id))
 				return FILE_ERROR;
+			// A deferred structure already has its name, which may be in use.
+			if (Names != in.name_table() || Struct_name != id)
+			{
+				Names = in.name_table();
+				Struct_name = id;
+			}
 			break;
+		}
 		case TEXT:
 		{
 			if (record_size != 4)
@@ -225,7 +588,7 @@ int Structure::read(std::ifstream &in, std::string &msg)
 				msg = ss.str();
 				return FORMAT_ERROR;
 			}
-			std::shared_ptr<Text> e = std::make_shared<Text>();
+			std::shared_ptr<Text> e = MakeElement<Text>(Storage.get());
 			int error_code = e->read(in, msg);
 			if (error_code > 0)
 				return error_code;
@@ -261,7 +624,7 @@ int Structure::read(std::ifstream &in, std::string &msg)
 				msg = ss.str();
 				return FORMAT_ERROR;
 			}
-			std::shared_ptr<Boundary> e = std::make_shared<Boundary>();
+			std::shared_ptr<Boundary> e = MakeElement<Boundary>(Storage.get());
 			int error_code = e->read(in, msg);
 			if (error_code > 0)
 				return error_code;
@@ -279,7 +642,7 @@ int Structure::read(std::ifstream &in, std::string &msg)
 				msg = ss.str();
 				return FORMAT_ERROR;
 			}
-			std::shared_ptr<Path> e = std::make_shared<Path>();
+			std::shared_ptr<Path> e = MakeElement<Path>(Storage.get());
 			int error_code = e->read(in, msg);
 			if (error_code > 0)
 				return error_code;
@@ -297,7 +660,7 @@ int Structure::read(std::ifstream &in, std::string &msg)
 				msg = ss.str();
 				return FORMAT_ERROR;
 			}
-			std::shared_ptr<SRef> e = std::make_shared<SRef>(); 
+			std::shared_ptr<SRef> e = MakeElement<SRef>(Storage.get()); 
 			int error_code = e->read(in, msg);
 			if (error_code > 0)
 				return error_code;
@@ -315,7 +678,7 @@ int Structure::read(std::ifstream &in, std::string &msg)
 				msg = ss.str();
 				return FORMAT_ERROR;
 			}
-			std::shared_ptr<ARef> e = std::make_shared<ARef>();
+			std::shared_ptr<ARef> e = MakeElement<ARef>(Storage.get());
 			int error_code = e->read(in, msg);
 			if (error_code > 0)
 				return error_code;
@@ -329,8 +692,12 @@ int Structure::read(std::ifstream &in, std::string &msg)
 	return 0;
 }
 
-int Structure::write(std::ofstream &out, std::string &msg)
+int Structure::write(Writer &out, std::string &msg)
 {
+	int error_code = load(msg);
+	if (error_code > 0)
+		return error_code;
+
 	short record_size;
 
 	record_size = 28;
@@ -350,13 +717,14 @@ int Structure::write(std::ofstream &out, std::string &msg)
 	writeShort(out, Acc_minute);
 	writeShort(out, Acc_second);
 
-	record_size = 4 + Struct_name.size();
+	const std::string &struct_name = Names->name(Struct_name);
+	record_size = 4 + struct_name.size();
 	if (record_size % 2 != 0)
 		record_size += 1;
 	writeShort(out, record_size);
 	writeByte(out, STRNAME);
 	writeByte(out, String);
-	writeString(out, Struct_name);
+	writeString(out, struct_name);
 
 	if (out.fail())
 		return FILE_ERROR;
@@ -25,12 +25,31 @@
 #include <string>
 #include <fstream>
 #include <memory>
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include "elements.h"
+#include "transform.h"
+#include "shapes.h"
+#include "names.h"
 
 namespace GDS {
+class Reader;
+class Writer;
+class RTree;
+class Arena;
+
+/*!
+	* Called by Structure::query() for each shape found, with the transform
+	* from the coordinates of the shape to those of the queried structure.
+	*/
+typedef std::function<void(const std::shared_ptr<Element> &, const Transform &)> ShapeVisitor;
 
 class Structure {
-	std::string     Struct_name;
+	friend class Library;
+
+	std::shared_ptr<NameTable> Names;
+	NameId          Struct_name;
 	short           Mod_year;
 	short           Mod_month;
 	short           Mod_day;
@@ -46,21 +65,167 @@ class Structure {
 
 	std::vector<std::shared_ptr<Element> > Elements;
 	std::vector<std::weak_ptr<Structure> > ReferBy;
+
+	// Storage of the elements created by read(), see set_arena(), and the
+	// arenas replaced while elements were still allocated from them.
+	std::shared_ptr<Arena>       Storage;
+	std::vector<std::shared_ptr<Arena> > Retired;
+
+	// Deferred reading of Elements, see set_loader().
+	std::function<int(Structure &, std::string &)> Loader;
+	std::atomic<bool>            Pending;
+	std::recursive_mutex         Load_mutex;
+	// Result of the loader, returned by every later load().
+	int                          Load_error;
+	std::string                  Load_msg;
+
+	// Cached result of bbox(), see Invalidate().
+	mutable std::mutex           BBox_mutex;
+	mutable bool                 BBox_valid;
+	mutable bool                 BBox_found;
+	mutable int                  BBox_x, BBox_y, BBox_w, BBox_h;
+
+	// Spatial index of the elements, see query().
+	mutable std::mutex                   Index_mutex;
+	mutable std::shared_ptr<const RTree> Index;
+
+	// Boundaries and paths bucketed by layer, see layers().
+	mutable std::mutex                   Layers_mutex;
+	mutable std::shared_ptr<const std::vector<ShapeArray> > Layers;
+
+	// Edits of the structure and of its hierarchy, see revision().
+	std::atomic<unsigned long long> Revision;
+
+	void InvalidateBounds();
+	void BumpRevision();
+
+	void ensureLoaded() const
+	{
+		if (Pending.load(std::memory_order_acquire))
+		{
+			std::string msg;
+			const_cast<Structure *>(this)->load(msg);
+		}
+	}
+
 public:
 	Structure();
-	Structure(std::string name);
+	Structure(std::string_view name);
+	Structure(std::shared_ptr<NameTable> names, NameId name);
 	~Structure();
 
-	std::string name() const;
+	const std::string &name() const;
+	/*!
+		* The interned name, an index into names().
+		*/
+	NameId nameId() const;
+	/*!
+		* The table of the name of the structure, usually the one of its
+		* library. Add() interns the names of the references added in it.
+		*/
+	const std::shared_ptr<NameTable> &names() const;
 	size_t size() const;
 	std::shared_ptr<Element> get(int index) const;
+	/*!
+		* All the elements, without copying their pointers. Prefer it to get()
+		* when many threads walk the same structure.
+		*/
+	const std::vector<std::shared_ptr<Element> > &elements() const;
+	/*!
+		* The bounding box of the structure, including its references. It is
+		* computed once and cached until Invalidate() is called.
+		*/
 	bool bbox(int &x, int &y, int &w, int &h) const;
+	/*!
+		* Collect the elements whose bounding box intersects the window.
+		*
+		* The spatial index is built by the first query and kept until
+		* Invalidate() is called.
+		*
+		* \param [in] window		The window, in the coordinates of the structure.
+		* \param [out] indices		The element indices, in ascending order.
+		*/
+	void query(const Box &window, std::vector<int> &indices) const;
+	/*!
+		* Visit the shapes (all elements but SREF and AREF) of the hierarchy
+		* under this structure which may intersect the window, without
+		* flattening it. Subtrees are pruned with the spatial index of each
+		* structure, and only the rows and columns of an AREF overlapping the
+		* window are visited when its lattice is axis-aligned.
+		*
+		* The test is exact for Manhattan placements and conservative, by
+		* bounding box, for the others.
+		*
+		* \param [in] window		The window, in the coordinates of this structure.
+		* \param [in] visitor		Called for each shape with its accumulated transform.
+		* \param [in] transform	The placement of this structure in the
+		*							coordinates of the window.
+		*/
+	void query(const Box &window, const ShapeVisitor &visitor,
+			   const Transform &transform = Transform()) const;
+	/*!
+		* The boundaries and paths of the structure itself, bucketed by
+		* (layer, datatype) in ascending order, with the shapes of a bucket in
+		* element order. The buckets are built on first use and kept until
+		* Invalidate() is called.
+		*/
+	std::shared_ptr<const std::vector<ShapeArray> > layers() const;
+	/*!
+		* Counter of the edits of the structure and of the structures it
+		* refers to, bumped by Invalidate(). Cached drawings of the structure
+		* are stale once it has changed.
+		*/
+	unsigned long long revision() const;
 
     void Add(std::shared_ptr<Element> new_element);
+	/*!
+		* Remove an element from the structure.
+		*
+		* \param [in] element		The element to remove.
+		*/
+    void Del(const std::shared_ptr<Element> &element);
     void AddReferBy(std::shared_ptr<Structure> cell);
+	/*!
+		* Drop the cached layer buckets of this structure, and the cached
+		* bounding box and spatial index of this structure and of every
+		* structure referring to it, and bump their revision(). Add() does
+		* this itself; call it after changing an element of the structure in
+		* place.
+		*/
+	void Invalidate();
+
+	/*!
+		* Defer reading the elements until they are first needed. The loader is
+		* called once, by the first access to the elements (size, get, bbox,
+		* Add or write), and is expected to fill the structure through read().
+		*
+		* \param [in] loader		Reads the elements into the structure.
+		*/
+	void set_loader(std::function<int(Structure &, std::string &)> loader);
+	/*!
+		* Run the pending loader, if any. If the loader failed, the elements
+		* read so far are dropped and the failure is kept: this and every later
+		* call return it, so writing the structure fails instead of writing it
+		* empty.
+		*
+		* \param [out] msg		The error message if the elements are malformed.
+		*
+		* \return	0 on success, otherwise the error code of the loader.
+		*/
+	int load(std::string &msg);
+	bool loaded() const;
+
+	/*!
+		* Allocate the elements created by read(), and their points, from the
+		* arena instead of one by one on the heap. Null restores the heap.
+		* The structure keeps the arena until it is destroyed, so its elements
+		* must not outlive it.
+		*/
+	void set_arena(std::shared_ptr<Arena> arena);
+	const std::shared_ptr<Arena> &arena() const;
 
-	int read(std::ifstream &in, std::string &msg);
-	int write(std::ofstream &out, std::string &msg);
+	int read(Reader &in, std::string &msg);
+	int write(Writer &out, std::string &msg);
 };
 
 }
@@ -24,6 +24,8 @@
 #include <map>
 #include <string>
 #include <limits>
+#include <memory_resource>
+#include <vector>
 
 namespace GDS {
 
@@ -53,6 +55,80 @@ struct Point
 	}
 };
 
+/*!
+	* Vertices of an element. They live in the arena of the structure when it
+	* has one, see Structure::set_arena().
+	*/
+typedef std::pmr::vector<Point> PointArray;
+
+/*!
+	* \brief Read-only view of the vertices of an element.
+	*
+	* It refers to the points of the element and stays valid until the
+	* element changes. The five points of a rectangle stored as a box are
+	* held by the view itself.
+	*/
+class PointView
+{
+	const Point *Data;
+	size_t      Count;
+	Point       Corners[5];
+
+public:
+	PointView() : Data(nullptr), Count(0) {}
+	PointView(const Point *data, size_t count) : Data(data), Count(count) {}
+	explicit PointView(const Point (&corners)[5]) : Data(Corners), Count(5)
+	{
+		for (int i = 0; i < 5; i++)
+			Corners[i] = corners[i];
+	}
+	PointView(const PointView &other) { *this = other; }
+	PointView &operator=(const PointView &other)
+	{
+		Count = other.Count;
+		Data = other.Data;
+		if (other.Data == other.Corners)
+		{
+			for (int i = 0; i < 5; i++)
+				Corners[i] = other.Corners[i];
+			Data = Corners;
+		}
+		return *this;
+	}
+
+	size_t size() const { return Count; }
+	bool empty() const { return Count == 0; }
+	const Point *data() const { return Data; }
+	const Point *begin() const { return Data; }
+	const Point *end() const { return Data + Count; }
+	const Point &operator[](size_t i) const { return Data[i]; }
+};
+
+/*!
+	* Axis-aligned box given by its lower left corner and size, the same
+	* convention as Element::bbox(). Boxes sharing an edge intersect.
+	*/
+struct Box
+{
+	int x, y, w, h;
+	Box(int x, int y, int w, int h)
+	{
+		this->x = x;
+		this->y = y;
+		this->w = w;
+		this->h = h;
+	}
+	Box()
+	{
+		x = y = w = h = 0;
+	}
+	bool intersects(const Box &other) const
+	{
+		return x <= (long long)other.x + other.w && other.x <= (long long)x + w
+			&& y <= (long long)other.y + other.h && other.y <= (long long)y + h;
+	}
+};
+
 enum STRANS_FLAG
 {
 	REFLECTION = 0x8000,
@@ -1,5 +1,6 @@
 #include <cassert>
 #include <cstdlib>
+#include <mutex>
 #include "techfile.h"
 
 namespace GDS
@@ -23,135 +24,106 @@ bool Techfile::AddLayer(short layer, short purpose,
                         std::string layer_name, std::string purpose_name,
                         std::string packet_name)
 {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
     // If the new layer has existed.
    // assert(layer >= 0 && layer <= 255);
    // assert(purpose >= 0 && layer <= 255);
 
-    bool layer_exist = (ParserLayer(layer) != "");
-    bool purpose_exist = (ParserPurpose(purpose) != "");
+    bool layer_exist = layer_names_.count(layer) > 0;
+    bool purpose_exist = purpose_names_.count(purpose) > 0;
     // check the layer_name is existed or not;
     if (!layer_exist && layers_.find(layer_name) != layers_.end())
         return false;
     if (!purpose_exist && purpose_.find(purpose_name) != purpose_.end())
         return false;
 
+    bool changed = false;
     if (layer_exist && layer_name != "" && layer_name != ParserLayer(layer))
+    {
         ChangeLayerName(layer, layer_name);
+        changed = true;
+    }
     else if (!layer_exist)
     {
         layer_name = (layer_name == "") ? "L" + std::to_string(layer) : layer_name;
         layers_.insert(std::make_pair(layer_name, layer));
+        layer_names_[layer] = layer_name;
     }
     if (purpose_exist && purpose_name != "" && purpose_name != ParserPurpose(purpose))
+    {
         ChangePurposeName(purpose, purpose_name);
+        changed = true;
+    }
     else if (!purpose_exist)
     {
         purpose_name = (purpose_name == "") ? "P" + std::to_string(purpose) : purpose_name;
         purpose_.insert(std::make_pair(purpose_name, purpose));
+        purpose_names_[purpose] = purpose_name;
     }
 
-    bool display_exist = false;
-    for (auto node : display_priority_)
+    int key = DisplayKey(layer, purpose);
+    if (display_index_.find(key) == display_index_.end())
     {
-        if (ParserLayer(layer) == node.layer_name()
-                && ParserPurpose(purpose) == node.purpose_name())
-        {
-            display_exist = true;
-            break;
-        }
-    }
-    if (!display_exist)
+        display_index_[key] = display_priority_.size();
         display_priority_.push_back(DisplayLayerNode(ParserLayer(layer), ParserPurpose(purpose), packet_name));
+        changed = true;
+    }
+    if (changed)
+        revision_.fetch_add(1, std::memory_order_release);
 
     return true;
 }
 
-bool Techfile::GetLayerColor(short layer, short purpose, int &r, int &g, int &b) const
+bool Techfile::GetDisplayLayer(short layer, short purpose, DisplayLayerNode &node) const
 {
-    std::string layer_name = ParserLayer(layer);
-    std::string purpose_name = ParserPurpose(purpose);
-    if (layer_name == "" || purpose_name == "")
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto iter = display_index_.find(DisplayKey(layer, purpose));
+    if (iter == display_index_.end())
         return false;
+    node = display_priority_[iter->second];
+    return true;
+}
 
-    bool existed = false;
-    for (auto n : display_priority_)
-    {
-        if (n.layer_name() == layer_name && n.purpose_name() == purpose_name)
-        {
-            existed = true;
-            n.color(r, g, b);
-            break;
-        }
-    }
-    return existed;
+bool Techfile::GetLayerColor(short layer, short purpose, int &r, int &g, int &b) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto iter = display_index_.find(DisplayKey(layer, purpose));
+    if (iter == display_index_.end())
+        return false;
+    display_priority_[iter->second].color(r, g, b);
+    return true;
 }
 
 bool Techfile::GetLayerStippleName(short layer, short purpose, std::string &stipple_name) const
 {
-    std::string layer_name = ParserLayer(layer);
-    std::string purpose_name = ParserPurpose(purpose);
-    if (layer_name == "" || purpose_name == "")
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto iter = display_index_.find(DisplayKey(layer, purpose));
+    if (iter == display_index_.end())
         return false;
-
-    bool existed = false;
-    for (auto n : display_priority_)
-    {
-        if (n.layer_name() == layer_name && n.purpose_name() == purpose_name)
-        {
-            existed = true;
-            stipple_name = n.stipple_name();
-            break;
-        }
-    }
-    return existed;
+    stipple_name = display_priority_[iter->second].stipple_name();
+    return true;
 }
 
 bool Techfile::GetLayerStipplePattern(short layer, short purpose, StipplePattern &pattern) const
 {
-    std::string layer_name = ParserLayer(layer);
-    std::string purpose_name = ParserPurpose(purpose);
-    if (layer_name == "" || purpose_name == "")
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto iter = display_index_.find(DisplayKey(layer, purpose));
+    if (iter == display_index_.end())
         return false;
-
-    bool existed = false;
-    for (auto n : display_priority_)
-    {
-        if (n.layer_name() == layer_name && n.purpose_name() == purpose_name)
-        {
-            existed = true;
-            pattern = n.stipple_pattern();
-            break;
-        }
-    }
-    return existed;
+    pattern = display_priority_[iter->second].stipple_pattern();
+    return true;
 }
 
 std::string Techfile::ParserLayer(short layer) const
 {
-    std::string ret = "";
-    for (auto iter = layers_.begin(); iter != layers_.end(); iter++)
-    {
-        if (iter->second == layer)
-        {
-            ret = iter->first;
-            break;
-        }
-    }
-    return ret;
+    auto iter = layer_names_.find(layer);
+    return iter == layer_names_.end() ? "" : iter->second;
 }
 
 std::string Techfile::ParserPurpose(short purpose) const
 {
-    std::string ret = "";
-    for (auto iter = purpose_.begin(); iter != purpose_.end(); iter++)
-    {
-        if (iter->second == purpose)
-        {
-            ret = iter->first;
-            break;
-        }
-    }
-    return ret;
+    auto iter = purpose_names_.find(purpose);
+    return iter == purpose_names_.end() ? "" : iter->second;
 }
 
 void Techfile::ChangeLayerName(short layer, std::string name)
@@ -167,6 +139,7 @@ void Techfile::ChangeLayerName(short layer, std::string name)
     auto iter = layers_.find(cur_name);
     layers_.erase(iter);
     layers_[name] = layer;
+    layer_names_[layer] = name;
 }
 
 void Techfile::ChangePurposeName(short purpose, std::string name)
@@ -182,6 +155,7 @@ void Techfile::ChangePurposeName(short purpose, std::string name)
     auto iter = purpose_.find(cur_name);
     purpose_.erase(iter);
     purpose_[name] = purpose;
+    purpose_names_[purpose] = name;
 }
 
 }
@@ -2,7 +2,10 @@
 #define GDS_TECHFILE_H
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
+#include <atomic>
+#include <shared_mutex>
 
 namespace GDS
 {
@@ -66,6 +69,19 @@ public:
     bool GetLayerColor(short layer, short purpose, int &r, int &g, int &b) const;
     bool GetLayerStippleName(short layer, short purpose, std::string &stipple_name) const;
     bool GetLayerStipplePattern(short layer, short purpose, StipplePattern &pattern) const;
+    /**
+     * @brief Get the display settings of a layer/purpose pair in one lookup.
+     * @param layer Layer number.
+     * @param purpose Purpose number.
+     * @param node The display settings, copied out.
+     * @return false if the pair is not existed.
+     */
+    bool GetDisplayLayer(short layer, short purpose, DisplayLayerNode &node) const;
+    /**
+     * @brief Counter increased by every change of the display settings, so that
+     *        styles derived from them can be cached until it changes.
+     */
+    unsigned int revision() const { return revision_.load(std::memory_order_acquire); }
 
 private:
     /**
@@ -88,9 +104,22 @@ private:
      */
     void ChangePurposeName(short purpose, std::string name);
 
+    static int DisplayKey(short layer, short purpose)
+    {
+        return int((unsigned short)layer) << 16 | (unsigned short)purpose;
+    }
+
     std::map<std::string, short> layers_;
     std::map<std::string, short> purpose_;
+    // Reverse of layers_ and purpose_.
+    std::unordered_map<short, std::string> layer_names_;
+    std::unordered_map<short, std::string> purpose_names_;
     std::vector<DisplayLayerNode> display_priority_;
+    // Index in display_priority_ of each layer/purpose pair, see DisplayKey().
+    std::unordered_map<int, size_t> display_index_;
+    // Guards the tables; painting threads only read them.
+    mutable std::shared_mutex mutex_;
+    std::atomic<unsigned int> revision_{0};
 };
 
 }
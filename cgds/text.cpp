@@ -106,7 +106,7 @@ bool Text::bbox(int &x, int &y, int &w, int &h) const
 	return false;
 }
 
-int Text::read(std::ifstream &in, std::string &msg)
+int Text::read(Reader &in, std::string &msg)
 {
 	msg = "";
 	bool finished = false;
@@ -226,7 +226,7 @@ int Text::read(std::ifstream &in, std::string &msg)
 	return 0;
 }
 
-int Text::write(std::ofstream &out, std::string &msg)
+int Text::write(Writer &out, std::string &msg)
 {
 	short record_size;
 
@@ -68,8 +68,8 @@ public:
     void set_xy(Point pt);
     void set_string(std::string string);
 
-	virtual int read(std::ifstream &in, std::string &msg);
-	virtual int write(std::ofstream &out, std::string &msg);
+	virtual int read(Reader &in, std::string &msg);
+	virtual int write(Writer &out, std::string &msg);
 };
 
 }
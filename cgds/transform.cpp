@@ -0,0 +1,235 @@
+/*
+ * This file is part of GDSII.
+ *
+ * transform.cpp -- The file which implements the placement transform of
+ *                  SREF and AREF instances.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <cmath>
+#include <algorithm>
+#include "transform.h"
+
+namespace GDS
+{
+
+static constexpr double kPi = 3.14159265358979323846;
+
+// Rotation matrices of the four quarter turns, as (a, b, c, d).
+static const int Quarter[4][4] = {
+	{ 1,  0,  0,  1 },
+	{ 0, -1,  1,  0 },
+	{-1,  0,  0, -1 },
+	{ 0,  1, -1,  0 },
+};
+
+static int roundCoord(double v)
+{
+	return int(std::llround(v));
+}
+
+Transform::Transform()
+{
+	A = D = 1;
+	B = C = 0;
+	Dx = Dy = 0;
+	Exact = true;
+	Ia = Id = 1;
+	Ib = Ic = 0;
+	Ix = Iy = 0;
+}
+
+Transform::Transform(Point offset, double mag, double angle, bool reflect)
+{
+	// Reflection about the x-axis negates the second column.
+	int sign = reflect ? -1 : 1;
+	double quarters = angle / 90.0;
+	Exact = mag == 1.0 && quarters == std::floor(quarters);
+	if (Exact)
+	{
+		int q = int(std::fmod(quarters, 4.0));
+		if (q < 0)
+			q += 4;
+		Ia = Quarter[q][0];
+		Ib = Quarter[q][1] * sign;
+		Ic = Quarter[q][2];
+		Id = Quarter[q][3] * sign;
+		A = Ia;
+		B = Ib;
+		C = Ic;
+		D = Id;
+	}
+	else
+	{
+		double rad = angle * kPi / 180.0;
+		double cs = std::cos(rad) * mag;
+		double sn = std::sin(rad) * mag;
+		A = cs;
+		B = -sn * sign;
+		C = sn;
+		D = cs * sign;
+		Ia = Ib = Ic = Id = 0;
+	}
+	Ix = offset.x;
+	Iy = offset.y;
+	Dx = offset.x;
+	Dy = offset.y;
+}
+
+bool Transform::manhattan() const
+{
+	return Exact;
+}
+
+double Transform::scale() const
+{
+	return std::sqrt(std::fabs(A * D - B * C));
+}
+
+Point Transform::map(Point pt) const
+{
+	if (Exact)
+		return Point(Ia * pt.x + Ib * pt.y + Ix, Ic * pt.x + Id * pt.y + Iy);
+	return Point(roundCoord(A * pt.x + B * pt.y + Dx),
+				 roundCoord(C * pt.x + D * pt.y + Dy));
+}
+
+void Transform::map(const Point *src, Point *dst, size_t count) const
+{
+	if (Exact)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			int x = src[i].x;
+			int y = src[i].y;
+			dst[i].x = Ia * x + Ib * y + Ix;
+			dst[i].y = Ic * x + Id * y + Iy;
+		}
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		double x = src[i].x;
+		double y = src[i].y;
+		dst[i].x = roundCoord(A * x + B * y + Dx);
+		dst[i].y = roundCoord(C * x + D * y + Dy);
+	}
+}
+
+void Transform::mapBox(int &x, int &y, int &w, int &h) const
+{
+	if (Exact)
+	{
+		// An orthogonal integer matrix maps the box onto a box; only the
+		// corners swap.
+		Point p1 = map(Point(x, y));
+		Point p2 = map(Point(x + w, y + h));
+		x = std::min(p1.x, p2.x);
+		y = std::min(p1.y, p2.y);
+		w = std::abs(p2.x - p1.x);
+		h = std::abs(p2.y - p1.y);
+		return;
+	}
+	double xs[4] = { double(x), double(x + w), double(x + w), double(x) };
+	double ys[4] = { double(y), double(y), double(y + h), double(y + h) };
+	double llx = HUGE_VAL, lly = HUGE_VAL, urx = -HUGE_VAL, ury = -HUGE_VAL;
+	for (int i = 0; i < 4; i++)
+	{
+		double mx = A * xs[i] + B * ys[i] + Dx;
+		double my = C * xs[i] + D * ys[i] + Dy;
+		llx = std::min(llx, mx);
+		lly = std::min(lly, my);
+		urx = std::max(urx, mx);
+		ury = std::max(ury, my);
+	}
+	x = int(std::floor(llx));
+	y = int(std::floor(lly));
+	w = int(std::ceil(urx)) - x;
+	h = int(std::ceil(ury)) - y;
+}
+
+Transform Transform::inverted() const
+{
+	Transform inv;
+	inv.Exact = Exact;
+	if (Exact)
+	{
+		// The inverse of an orthogonal matrix is its transpose.
+		inv.Ia = Ia;
+		inv.Ib = Ic;
+		inv.Ic = Ib;
+		inv.Id = Id;
+		inv.Ix = -(inv.Ia * Ix + inv.Ib * Iy);
+		inv.Iy = -(inv.Ic * Ix + inv.Id * Iy);
+		inv.A = inv.Ia;
+		inv.B = inv.Ib;
+		inv.C = inv.Ic;
+		inv.D = inv.Id;
+		inv.Dx = inv.Ix;
+		inv.Dy = inv.Iy;
+		return inv;
+	}
+	double det = A * D - B * C;
+	inv.A = D / det;
+	inv.B = -B / det;
+	inv.C = -C / det;
+	inv.D = A / det;
+	inv.Dx = -(inv.A * Dx + inv.B * Dy);
+	inv.Dy = -(inv.C * Dx + inv.D * Dy);
+	inv.Ia = inv.Ib = inv.Ic = inv.Id = 0;
+	inv.Ix = inv.Iy = 0;
+	return inv;
+}
+
+Transform Transform::operator*(const Transform &child) const
+{
+	Transform t;
+	t.Exact = Exact && child.Exact;
+	t.A = A * child.A + B * child.C;
+	t.B = A * child.B + B * child.D;
+	t.C = C * child.A + D * child.C;
+	t.D = C * child.B + D * child.D;
+	t.Dx = A * child.Dx + B * child.Dy + Dx;
+	t.Dy = C * child.Dx + D * child.Dy + Dy;
+	if (t.Exact)
+	{
+		t.Ia = Ia * child.Ia + Ib * child.Ic;
+		t.Ib = Ia * child.Ib + Ib * child.Id;
+		t.Ic = Ic * child.Ia + Id * child.Ic;
+		t.Id = Ic * child.Ib + Id * child.Id;
+		t.Ix = Ia * child.Ix + Ib * child.Iy + Ix;
+		t.Iy = Ic * child.Ix + Id * child.Iy + Iy;
+	}
+	else
+	{
+		t.Ia = t.Ib = t.Ic = t.Id = 0;
+		t.Ix = t.Iy = 0;
+	}
+	return t;
+}
+
+Transform Transform::translated(int x, int y) const
+{
+	Transform t = *this;
+	t.Dx += x;
+	t.Dy += y;
+	t.Ix += x;
+	t.Iy += y;
+	return t;
+}
+
+}
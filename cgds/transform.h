@@ -0,0 +1,84 @@
+/*
+ * This file is part of GDSII.
+ *
+ * transform.h -- The header file which declare the placement transform of
+ *                SREF and AREF instances.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_TRANSFORM_H
+#define GDS_TRANSFORM_H
+#include "tags.h"
+
+namespace GDS {
+
+/*!
+	* \brief Affine transform of a structure instance.
+	*
+	* A point p of the referenced structure is placed at
+	* offset + rotate(angle) * mag * reflect(p), which is the order GDSII
+	* applies STRANS. Transforms with mag 1, an angle multiple of 90 degrees
+	* and integer offsets (the eight Manhattan orientations) map points with
+	* exact integer arithmetic; all others use a double matrix.
+	*
+	* Matrix form: x' = a * x + b * y + dx, y' = c * x + d * y + dy.
+	*/
+class Transform {
+	double  A, B, C, D;
+	double  Dx, Dy;
+	bool    Exact;
+	int     Ia, Ib, Ic, Id;
+	int     Ix, Iy;
+
+public:
+	Transform();
+	Transform(Point offset, double mag = 1.0, double angle = 0.0, bool reflect = false);
+
+	bool manhattan() const;
+	double a() const { return A; }
+	double b() const { return B; }
+	double c() const { return C; }
+	double d() const { return D; }
+	double dx() const { return Dx; }
+	double dy() const { return Dy; }
+	/*!
+		* The linear magnification of the transform.
+		*/
+	double scale() const;
+
+	Point map(Point pt) const;
+	/*!
+		* Map count points from src to dst, which may be the same array.
+		*/
+	void map(const Point *src, Point *dst, size_t count) const;
+	/*!
+		* Map a box given by its lower left corner and size, and replace it by
+		* the bounding box of the result.
+		*/
+	void mapBox(int &x, int &y, int &w, int &h) const;
+	Transform inverted() const;
+	/*!
+		* Compose two transforms: (parent * child) maps through child first,
+		* so a hierarchy stack is accumulated as top * ... * leaf.
+		*/
+	Transform operator*(const Transform &child) const;
+	Transform translated(int x, int y) const;
+};
+
+}
+
+#endif // GDS_TRANSFORM_H
@@ -0,0 +1,27 @@
+#-------------------------------------------------
+#
+# Lazy opening of a library with a malformed structure.
+#
+#-------------------------------------------------
+
+QT       -= gui
+
+TARGET = lazyopen
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+SOURCES += main.cpp
+
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../../cgds/release/ -lcgds
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../../cgds/debug/ -lcgds
+else:unix: LIBS += -L$$OUT_PWD/../../cgds/ -lcgds
+
+INCLUDEPATH += $$PWD/../../cgds
+DEPENDPATH += $$PWD/../../cgds
+
+win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../cgds/release/libcgds.a
+else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../cgds/debug/libcgds.a
+else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../cgds/release/cgds.lib
+else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../cgds/debug/cgds.lib
+else:unix: PRE_TARGETDEPS += $$OUT_PWD/../../cgds/libcgds.a
@@ -0,0 +1,105 @@
+// Opens a library lazily whose structure has a malformed LAYER record, and
+// checks that the error is reported by every later use of the structure.
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "library.h"
+#include "structures.h"
+#include "boundary.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static bool save(const std::string &file_name, const std::vector<char> &bytes)
+{
+    std::ofstream out(file_name, std::ofstream::binary);
+    out.write(bytes.data(), bytes.size());
+    return !out.fail();
+}
+
+int main()
+{
+    std::string good_name = "lazyopen_good.gds";
+    std::string bad_name = "lazyopen_bad.gds";
+    std::string msg;
+
+    GDS::Library gds;
+    for (const char *name : { "GOOD", "BAD" })
+    {
+        std::shared_ptr<GDS::Structure> cell = gds.Add(name);
+        std::shared_ptr<GDS::Boundary> polygon = std::make_shared<GDS::Boundary>();
+        polygon->set_xy({ GDS::Point(0, 0), GDS::Point(100, 0), GDS::Point(50, 80), GDS::Point(0, 0) });
+        polygon->set_layer(name[0] == 'B' ? 7 : 1);
+        polygon->set_data_type(0);
+        cell->Add(polygon);
+    }
+    {
+        std::ofstream out(good_name, std::ofstream::binary);
+        check(gds.write(out, msg) == 0, "write the source library");
+    }
+
+    // Grow the LAYER record of BAD (layer 7) to 8 bytes. The records still
+    // chain, so only parsing the elements of BAD notices it.
+    std::ifstream in(good_name, std::ifstream::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    const char layer[] = { 0x00, 0x06, 0x0d, 0x02, 0x00, 0x07 };
+    auto pos = std::search(bytes.begin(), bytes.end(), layer, layer + sizeof(layer));
+    check(pos != bytes.end(), "find the LAYER record");
+    if (pos == bytes.end())
+        return 1;
+    pos[1] = 0x08;
+    bytes.insert(pos + sizeof(layer), 2, 0);
+    check(save(bad_name, bytes), "write the corrupt library");
+
+    GDS::Library eager;
+    check(eager.read(bad_name, msg) == GDS::FORMAT_ERROR, "read reports the error");
+
+    GDS::Library lazy;
+    check(lazy.open(bad_name, msg) == 0, "open only scans the records");
+    std::shared_ptr<GDS::Structure> good = lazy.get("GOOD");
+    std::shared_ptr<GDS::Structure> bad = lazy.get("BAD");
+    check(good && bad, "open lists the structures");
+    if (!good || !bad)
+        return 1;
+    check(good->load(msg) == 0 && good->size() == 1, "load the intact structure");
+
+    msg.clear();
+    check(bad->load(msg) == GDS::FORMAT_ERROR && !msg.empty(), "load reports the error");
+    check(bad->loaded() && bad->size() == 0, "the failed structure is empty");
+    msg.clear();
+    check(bad->load(msg) == GDS::FORMAT_ERROR && !msg.empty(), "a later load reports it again");
+
+    std::string out_name = "lazyopen_out.gds";
+    {
+        std::ofstream out(out_name, std::ofstream::binary);
+        msg.clear();
+        check(lazy.write(out, msg) == GDS::FORMAT_ERROR && !msg.empty(), "write reports the error");
+        msg.clear();
+        check(lazy.write(out, msg, 4) == GDS::FORMAT_ERROR && !msg.empty(), "parallel write reports the error");
+    }
+    msg.clear();
+    check(lazy.write_snapshot("lazyopen_out.snap", bad_name, msg) == GDS::FORMAT_ERROR,
+          "write_snapshot reports the error");
+
+    std::remove(good_name.c_str());
+    std::remove(bad_name.c_str());
+    std::remove(out_name.c_str());
+    std::remove("lazyopen_out.snap");
+
+    if (failures == 0)
+        std::cout << "lazyopen: passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
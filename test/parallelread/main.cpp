@@ -0,0 +1,141 @@
+// Reads the same library with one thread and with several, and checks that
+// both give the same structures, in the same order, with the same elements
+// and links.
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "library.h"
+#include "structures.h"
+#include "boundary.h"
+#include "path.h"
+#include "text.h"
+#include "sref.h"
+#include "aref.h"
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static std::string stream(GDS::Library &gds)
+{
+    std::string msg;
+    std::string file_name = "parallelread_out.gds";
+    {
+        std::ofstream out(file_name, std::ofstream::binary);
+        if (gds.write(out, msg) != 0)
+            return std::string();
+    }
+    std::ifstream in(file_name, std::ifstream::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::remove(file_name.c_str());
+    return bytes;
+}
+
+// Every structure refers to the two before it, so that the links matter.
+static void fill(GDS::Library &gds, int cells)
+{
+    for (int i = 0; i < cells; i++)
+    {
+        std::shared_ptr<GDS::Structure> cell = gds.Add("CELL_" + std::to_string(i));
+        for (int j = 0; j < 20; j++)
+        {
+            std::shared_ptr<GDS::Boundary> polygon = std::make_shared<GDS::Boundary>();
+            polygon->set_xy({ GDS::Point(j, i), GDS::Point(j + 100, i), GDS::Point(j + 50, i + 80),
+                              GDS::Point(j, i) });
+            polygon->set_layer(short(j % 4));
+            polygon->set_data_type(0);
+            cell->Add(polygon);
+        }
+        std::shared_ptr<GDS::Path> wire = std::make_shared<GDS::Path>();
+        wire->set_xy({ GDS::Point(0, 0), GDS::Point(i * 10, 0), GDS::Point(i * 10, 500) });
+        wire->set_layer(5);
+        wire->set_width(20);
+        cell->Add(wire);
+        std::shared_ptr<GDS::Text> label = std::make_shared<GDS::Text>();
+        label->set_layer(6);
+        label->set_string("cell " + std::to_string(i));
+        label->set_xy(GDS::Point(i, i));
+        cell->Add(label);
+        if (i >= 1)
+        {
+            std::shared_ptr<GDS::SRef> sref = std::make_shared<GDS::SRef>();
+            sref->set_struct_name("CELL_" + std::to_string(i - 1));
+            sref->set_xy(GDS::Point(1000, i));
+            cell->Add(sref);
+        }
+        if (i >= 2)
+        {
+            std::shared_ptr<GDS::ARef> aref = std::make_shared<GDS::ARef>();
+            aref->set_struct_name("CELL_" + std::to_string(i - 2));
+            aref->set_row_col(2, 3);
+            aref->set_xy({ GDS::Point(0, 0), GDS::Point(3000, 0), GDS::Point(0, 2000) });
+            cell->Add(aref);
+        }
+    }
+}
+
+int main()
+{
+    std::string file_name = "parallelread.gds";
+    std::string msg;
+    const int cells = 200;
+    {
+        GDS::Library gds;
+        fill(gds, cells);
+        std::ofstream out(file_name, std::ofstream::binary);
+        check(gds.write(out, msg) == 0, "write the library");
+    }
+
+    GDS::Library serial;
+    check(serial.read(file_name, msg, 1) == 0, "read with one thread");
+    serial.BuildCellLinks();
+    std::string expected = stream(serial);
+    check(!expected.empty(), "write the serial library");
+
+    for (unsigned int threads : { 2u, 4u, 7u, 0u })
+    {
+        std::string what = std::to_string(threads) + " threads";
+        GDS::Library parallel;
+        check(parallel.read(file_name, msg, threads) == 0, "read with " + what);
+        parallel.BuildCellLinks();
+        check(parallel.size() == serial.size(), what + " read every structure");
+        if (parallel.size() != serial.size())
+            continue;
+        bool same_cells = true;
+        bool same_links = true;
+        for (size_t i = 0; i < serial.size(); i++)
+        {
+            auto a = serial.get(int(i));
+            auto b = parallel.get(int(i));
+            same_cells = same_cells && a->name() == b->name() && a->size() == b->size();
+            for (size_t k = 0; k < b->size() && same_links; k++)
+            {
+                auto sref = std::dynamic_pointer_cast<GDS::SRef>(b->get(int(k)));
+                if (sref)
+                    same_links = sref->reference() == parallel.get(sref->structName());
+            }
+        }
+        check(same_cells, what + " give the same structures in the same order");
+        check(same_links, what + " link the references");
+        check(stream(parallel) == expected, what + " write the same stream");
+    }
+
+    std::remove(file_name.c_str());
+
+    if (failures == 0)
+        std::cout << "parallelread: passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+// Writes the same library with one thread and with several, eagerly read
+// and lazily opened, and checks that the streams are identical.
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include "library.h"
+#include "structures.h"
+#include "boundary.h"
+#include "path.h"
+#include "sref.h"
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static std::string stream(GDS::Library &gds, unsigned int threads)
+{
+    std::string msg;
+    std::string file_name = "parallelwrite_out.gds";
+    {
+        std::ofstream out(file_name, std::ofstream::binary);
+        if (gds.write(out, msg, threads) != 0)
+            return std::string();
+    }
+    std::ifstream in(file_name, std::ifstream::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::remove(file_name.c_str());
+    return bytes;
+}
+
+int main()
+{
+    std::string file_name = "parallelwrite.gds";
+    std::string msg;
+
+    GDS::Library gds;
+    // Structures of very different sizes, so that they finish out of order.
+    for (int i = 0; i < 150; i++)
+    {
+        std::shared_ptr<GDS::Structure> cell = gds.Add("CELL_" + std::to_string(i));
+        int count = (i % 7 == 0) ? 2000 : i % 5;
+        for (int j = 0; j < count; j++)
+        {
+            std::shared_ptr<GDS::Boundary> polygon = std::make_shared<GDS::Boundary>();
+            polygon->set_xy({ GDS::Point(j, i), GDS::Point(j + 10, i), GDS::Point(j + 5, i + 8),
+                              GDS::Point(j, i) });
+            polygon->set_layer(short(j % 3));
+            polygon->set_data_type(0);
+            cell->Add(polygon);
+        }
+        std::shared_ptr<GDS::Path> wire = std::make_shared<GDS::Path>();
+        wire->set_xy({ GDS::Point(0, 0), GDS::Point(i, 0) });
+        wire->set_layer(4);
+        wire->set_width(2);
+        cell->Add(wire);
+        if (i > 0)
+        {
+            std::shared_ptr<GDS::SRef> sref = std::make_shared<GDS::SRef>();
+            sref->set_struct_name("CELL_" + std::to_string(i - 1));
+            sref->set_xy(GDS::Point(100, 100));
+            cell->Add(sref);
+        }
+    }
+    std::string expected = stream(gds, 1);
+    check(!expected.empty(), "write with one thread");
+    for (unsigned int threads : { 2u, 4u, 9u, 0u })
+        check(stream(gds, threads) == expected, "write with " + std::to_string(threads) + " threads");
+
+    {
+        std::ofstream out(file_name, std::ofstream::binary);
+        out.write(expected.data(), expected.size());
+    }
+    GDS::Library lazy;
+    check(lazy.open(file_name, msg) == 0, "open the library lazily");
+    check(stream(lazy, 4) == expected, "write the lazy library with 4 threads");
+    GDS::Library lazy_serial;
+    check(lazy_serial.open(file_name, msg) == 0, "open the library lazily again");
+    check(stream(lazy_serial, 1) == expected, "write the lazy library with one thread");
+
+    std::remove(file_name.c_str());
+
+    if (failures == 0)
+        std::cout << "parallelwrite: passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+// Checks Structure::query through SREF and AREF instances against a walk of
+// every shape of the expanded hierarchy. A shape whose placed box overlaps
+// the window must be visited, and a shape whose placed box, rounded out to
+// integers, misses the window must not be. The two agree for Manhattan
+// placements; rotated ones may differ by the rounding.
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "library.h"
+#include "structures.h"
+#include "boundary.h"
+#include "path.h"
+#include "sref.h"
+#include "aref.h"
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+// A shape at one placement: the element and its placed box, rounded out.
+typedef std::tuple<const GDS::Element *, int, int, int, int> Key;
+
+static Key key(const std::shared_ptr<GDS::Element> &node, const GDS::Transform &transform)
+{
+    GDS::Box b;
+    node->bbox(b.x, b.y, b.w, b.h);
+    transform.mapBox(b.x, b.y, b.w, b.h);
+    return Key(node.get(), b.x, b.y, b.w, b.h);
+}
+
+// Whether the box of the shape, placed without rounding, overlaps the window:
+// separating axis test of the placed parallelogram against the window.
+static bool overlaps(const GDS::Box &shape, const GDS::Transform &t, const GDS::Box &window, double slack)
+{
+    double px[4], py[4];
+    double xs[4] = { double(shape.x), double(shape.x) + shape.w, double(shape.x) + shape.w, double(shape.x) };
+    double ys[4] = { double(shape.y), double(shape.y), double(shape.y) + shape.h, double(shape.y) + shape.h };
+    for (int i = 0; i < 4; i++)
+    {
+        px[i] = t.a() * xs[i] + t.b() * ys[i] + t.dx();
+        py[i] = t.c() * xs[i] + t.d() * ys[i] + t.dy();
+    }
+    double wx[4] = { double(window.x), double(window.x) + window.w, double(window.x) + window.w, double(window.x) };
+    double wy[4] = { double(window.y), double(window.y), double(window.y) + window.h, double(window.y) + window.h };
+    // The axes of the window and the normals of the placed edges.
+    double axes[4][2] = { { 1, 0 }, { 0, 1 }, { -(py[1] - py[0]), px[1] - px[0] }, { -(py[3] - py[0]), px[3] - px[0] } };
+    for (auto &axis : axes)
+    {
+        double length = std::hypot(axis[0], axis[1]);
+        if (length == 0)
+            continue;
+        double lo1 = HUGE_VAL, hi1 = -HUGE_VAL, lo2 = HUGE_VAL, hi2 = -HUGE_VAL;
+        for (int i = 0; i < 4; i++)
+        {
+            double p = (axis[0] * px[i] + axis[1] * py[i]) / length;
+            double w = (axis[0] * wx[i] + axis[1] * wy[i]) / length;
+            lo1 = std::min(lo1, p);
+            hi1 = std::max(hi1, p);
+            lo2 = std::min(lo2, w);
+            hi2 = std::max(hi2, w);
+        }
+        if (std::min(hi1, hi2) - std::max(lo1, lo2) < slack)
+            return false;
+    }
+    return true;
+}
+
+struct Expected
+{
+    int must = 0;
+    int may = 0;
+};
+
+static void walk(const GDS::Structure &cell, const GDS::Transform &transform, const GDS::Box &window,
+                 std::map<Key, Expected> &expected)
+{
+    for (const std::shared_ptr<GDS::Element> &node : cell.elements())
+    {
+        if (node->tag() == GDS::SREF)
+        {
+            auto sref = std::static_pointer_cast<GDS::SRef>(node);
+            GDS::Transform placement(sref->xy(), sref->mag(), sref->angle(), sref->stransFlag(GDS::REFLECTION));
+            walk(*sref->reference(), transform * placement, window, expected);
+        }
+        else if (node->tag() == GDS::AREF)
+        {
+            auto aref = std::static_pointer_cast<GDS::ARef>(node);
+            GDS::PointView pts = aref->points();
+            int rows = aref->row();
+            int cols = aref->col();
+            for (int r = 0; r < rows; r++)
+            {
+                for (int c = 0; c < cols; c++)
+                {
+                    GDS::Point origin(pts[0].x + r * ((pts[2].x - pts[0].x) / rows) + c * ((pts[1].x - pts[0].x) / cols),
+                                      pts[0].y + r * ((pts[2].y - pts[0].y) / rows) + c * ((pts[1].y - pts[0].y) / cols));
+                    GDS::Transform placement(origin, aref->mag(), aref->angle(), aref->stransFlag(GDS::REFLECTION));
+                    walk(*aref->reference(), transform * placement, window, expected);
+                }
+            }
+        }
+        else
+        {
+            GDS::Box shape;
+            if (!node->bbox(shape.x, shape.y, shape.w, shape.h))
+                continue;
+            Key k = key(node, transform);
+            GDS::Box placed(std::get<1>(k), std::get<2>(k), std::get<3>(k), std::get<4>(k));
+            Expected &e = expected[k];
+            if (overlaps(shape, transform, window, transform.manhattan() ? 0 : 1e-6))
+                e.must++;
+            if (placed.intersects(window))
+                e.may++;
+        }
+    }
+}
+
+static std::shared_ptr<GDS::SRef> sref(const std::shared_ptr<GDS::Structure> &cell, const char *name, GDS::Point xy,
+                                       double angle, double mag, bool reflect)
+{
+    auto ref = std::make_shared<GDS::SRef>();
+    ref->set_struct_name(name);
+    ref->set_reference(cell);
+    ref->set_xy(xy);
+    ref->set_angle(angle);
+    ref->set_mag(mag);
+    ref->set_strans(GDS::REFLECTION, reflect);
+    return ref;
+}
+
+static std::shared_ptr<GDS::ARef> aref(const std::shared_ptr<GDS::Structure> &cell, const char *name, int rows,
+                                       int cols, std::initializer_list<GDS::Point> pts, double angle, bool reflect)
+{
+    auto ref = std::make_shared<GDS::ARef>();
+    ref->set_struct_name(name);
+    ref->set_reference(cell);
+    ref->set_row_col(rows, cols);
+    ref->set_xy(pts);
+    ref->set_angle(angle);
+    ref->set_strans(GDS::REFLECTION, reflect);
+    return ref;
+}
+
+int main()
+{
+    std::mt19937 random(2024);
+    GDS::Library gds;
+
+    std::shared_ptr<GDS::Structure> leaf = gds.Add("LEAF");
+    std::uniform_int_distribution<int> coord(0, 900);
+    std::uniform_int_distribution<int> size(0, 100);
+    for (int i = 0; i < 40; i++)
+    {
+        auto rect = std::make_shared<GDS::Boundary>();
+        int x = coord(random);
+        int y = coord(random);
+        int w = i % 10 == 0 ? 0 : size(random) + 1;
+        int h = size(random) + 1;
+        rect->set_xy({ GDS::Point(x, y), GDS::Point(x + w, y), GDS::Point(x + w, y + h), GDS::Point(x, y + h),
+                       GDS::Point(x, y) });
+        leaf->Add(rect);
+    }
+    auto wire = std::make_shared<GDS::Path>();
+    wire->set_xy({ GDS::Point(0, 0), GDS::Point(0, 700), GDS::Point(600, 700) });
+    wire->set_width(20);
+    leaf->Add(wire);
+
+    std::shared_ptr<GDS::Structure> mid = gds.Add("MID");
+    auto triangle = std::make_shared<GDS::Boundary>();
+    triangle->set_xy({ GDS::Point(-500, -500), GDS::Point(0, -500), GDS::Point(-250, -100), GDS::Point(-500, -500) });
+    mid->Add(triangle);
+    mid->Add(sref(leaf, "LEAF", GDS::Point(3000, 0), 90, 1, true));
+    mid->Add(sref(leaf, "LEAF", GDS::Point(-2000, 1500), 30, 1.5, false));
+    // An axis-aligned array, a skewed one and a rotated and reflected one.
+    mid->Add(aref(leaf, "LEAF", 3, 4, { GDS::Point(0, 3000), GDS::Point(4400, 3000), GDS::Point(0, 6300) }, 0, false));
+    mid->Add(aref(leaf, "LEAF", 5, 6, { GDS::Point(-8000, -8000), GDS::Point(-2000, -6500), GDS::Point(-9000, -2000) },
+                  0, false));
+    mid->Add(aref(leaf, "LEAF", 4, 3, { GDS::Point(6000, -6000), GDS::Point(9000, -6000), GDS::Point(6000, -2000) },
+                  270, true));
+
+    std::shared_ptr<GDS::Structure> top = gds.Add("TOP");
+    top->Add(sref(mid, "MID", GDS::Point(0, 0), 0, 1, false));
+    top->Add(sref(mid, "MID", GDS::Point(40000, 10000), 180, 1, true));
+    top->Add(sref(mid, "MID", GDS::Point(-30000, 25000), 45, 0.75, false));
+    top->Add(aref(mid, "MID", 2, 2, { GDS::Point(0, -40000), GDS::Point(50000, -40000), GDS::Point(0, -10000) }, 90,
+                  false));
+
+    GDS::Box bounds;
+    check(top->bbox(bounds.x, bounds.y, bounds.w, bounds.h), "the hierarchy has a box");
+    std::uniform_int_distribution<int> wx(bounds.x - 2000, bounds.x + bounds.w);
+    std::uniform_int_distribution<int> wy(bounds.y - 2000, bounds.y + bounds.h);
+    std::uniform_int_distribution<int> wsize(0, 6000);
+    std::vector<GDS::Box> windows = { bounds, GDS::Box(bounds.x - 10, bounds.y - 10, 5, 5) };
+    for (int i = 0; i < 300; i++)
+        windows.emplace_back(wx(random), wy(random), wsize(random), wsize(random));
+
+    size_t visited = 0;
+    for (size_t n = 0; n < windows.size(); n++)
+    {
+        const GDS::Box &window = windows[n];
+        std::string what = "window " + std::to_string(n);
+        std::map<Key, Expected> expected;
+        walk(*top, GDS::Transform(), window, expected);
+
+        std::map<Key, int> found;
+        top->query(window, [&](const std::shared_ptr<GDS::Element> &node, const GDS::Transform &transform) {
+            check(node->tag() != GDS::SREF && node->tag() != GDS::AREF, what + ": only shapes are visited");
+            found[key(node, transform)]++;
+        });
+        for (auto &entry : found)
+        {
+            auto iter = expected.find(entry.first);
+            check(iter != expected.end() && entry.second <= iter->second.may, what + ": visits a missed shape");
+            visited += entry.second;
+        }
+        for (auto &entry : expected)
+        {
+            auto iter = found.find(entry.first);
+            check((iter == found.end() ? 0 : iter->second) >= entry.second.must, what + ": misses a shape");
+        }
+    }
+    check(visited > 0, "the windows hit shapes");
+
+    if (failures == 0)
+        std::cout << "query: passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+// Round trips of doubles through the GDSII real8 codec, at zero, at the
+// largest and smallest exponents and through the denormalized range.
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include "gdsio.h"
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static bool sameBytes(const GDS::Byte *a, const GDS::Byte *b)
+{
+    return memcmp(a, b, 8) == 0;
+}
+
+// The double survives encoding and decoding unchanged.
+static void checkRoundTrip(double value, const std::string &what)
+{
+    GDS::Byte data[8];
+    GDS::encodeReal8(value, data);
+    double back = GDS::decodeReal8(data);
+    check(back == value, what + " round trips");
+}
+
+// The real survives decoding and encoding unchanged, and decodes to value.
+static void checkReal(const GDS::Byte *data, double value, const std::string &what)
+{
+    double decoded = GDS::decodeReal8(data);
+    check(decoded == value, what + " decodes");
+    GDS::Byte back[8];
+    GDS::encodeReal8(decoded, back);
+    check(sameBytes(data, back), what + " encodes back");
+}
+
+static void checkEncode(double value, const GDS::Byte *expected, const std::string &what)
+{
+    GDS::Byte data[8];
+    GDS::encodeReal8(value, data);
+    check(sameBytes(data, expected), what + " encodes");
+}
+
+int main()
+{
+    const GDS::Byte zero[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    checkEncode(0.0, zero, "0");
+    checkEncode(-0.0, zero, "-0");
+    check(GDS::decodeReal8(zero) == 0, "0 decodes");
+
+    for (double value : { 1.0, -1.0, 0.5, 0.1, 1e-3, 1e-9, 90.0, -270.0, 3.14159, 1.0 / 16, 1e70, 1e-70 })
+        checkRoundTrip(value, std::to_string(value));
+
+    // Largest magnitude: 16^63 * (1 - 2^-56), which needs 56 bits and so
+    // decodes to the nearest double, 16^63.
+    const GDS::Byte largest[8] = { 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    const GDS::Byte largest_double[8] = { 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf8 };
+    check(GDS::decodeReal8(largest) == std::ldexp(1.0, 252), "largest real decodes");
+    checkReal(largest_double, std::ldexp(1.0, 252) - std::ldexp(1.0, 252 - 53), "largest double");
+    checkEncode(std::ldexp(1.0, 252), largest, "16^63");
+    checkEncode(1e300, largest, "1e300");
+    checkEncode(std::numeric_limits<double>::infinity(), largest, "infinity");
+    const GDS::Byte negative_largest[8] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    checkEncode(-1e300, negative_largest, "-1e300");
+
+    // Smallest normalized real, 16^-65, and the denormals below it, down to
+    // the smallest step 2^-312.
+    const GDS::Byte smallest_normal[8] = { 0x00, 0x10, 0, 0, 0, 0, 0, 0 };
+    checkReal(smallest_normal, std::ldexp(1.0, -260), "16^-65");
+    const GDS::Byte smallest[8] = { 0, 0, 0, 0, 0, 0, 0, 0x01 };
+    checkReal(smallest, std::ldexp(1.0, -312), "2^-312");
+    const GDS::Byte three[8] = { 0, 0, 0, 0, 0, 0, 0, 0x03 };
+    checkReal(three, std::ldexp(3.0, -312), "3 * 2^-312");
+    const GDS::Byte denormal[8] = { 0x80, 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd };
+    checkReal(denormal, -std::ldexp(double(0x0123456789abcdLL), -312), "a negative denormal");
+
+    // Rounding of the denormals to the nearest even step.
+    checkEncode(std::ldexp(1.0, -313), zero, "2^-313");
+    checkEncode(std::ldexp(1.0, -313) * 1.5, smallest, "1.5 * 2^-313");
+    const GDS::Byte two[8] = { 0, 0, 0, 0, 0, 0, 0, 0x02 };
+    checkEncode(std::ldexp(3.0, -313), two, "3 * 2^-313");
+    checkEncode(std::ldexp(1.0, -400), zero, "2^-400");
+    checkEncode(std::numeric_limits<double>::denorm_min(), zero, "the smallest subnormal double");
+    checkEncode(std::numeric_limits<double>::quiet_NaN(), zero, "NaN");
+
+    // Every GDSII exponent, with random 53-bit mantissas.
+    std::mt19937_64 random(1);
+    for (int exponent = 0; exponent < 128; exponent++)
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            double mantissa = double((random() >> 11) | (uint64_t(1) << 52)) * std::ldexp(1.0, -53);
+            double value = std::ldexp(mantissa, 4 * (exponent - 64));
+            if (i % 2)
+                value = -value;
+            GDS::Byte data[8];
+            GDS::encodeReal8(value, data);
+            if (GDS::decodeReal8(data) != value || (data[0] & 0x7f) != exponent)
+            {
+                check(false, "exponent " + std::to_string(exponent) + " round trips");
+                break;
+            }
+        }
+    }
+
+    // Denormals with random steps.
+    for (int i = 0; i < 1000; i++)
+    {
+        double value = std::ldexp(double(random() >> (12 + i % 52)), -312);
+        GDS::Byte data[8];
+        GDS::encodeReal8(value, data);
+        if (GDS::decodeReal8(data) != value || data[0] != 0)
+        {
+            check(false, "denormal " + std::to_string(i) + " round trips");
+            break;
+        }
+    }
+
+    if (failures == 0)
+        std::cout << "real8: passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
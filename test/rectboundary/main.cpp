@@ -0,0 +1,121 @@
+// Writes rectangles with their corners in each of the 8 possible orders,
+// reads them back and checks that each is stored as a box and written with
+// its points in the original order.
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "library.h"
+#include "structures.h"
+#include "boundary.h"
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static bool samePoints(const std::vector<GDS::Point> &a, const std::vector<GDS::Point> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].x != b[i].x || a[i].y != b[i].y)
+            return false;
+    }
+    return true;
+}
+
+// The corners of the box from corner `first`, counterclockwise or not, closed.
+static std::vector<GDS::Point> corners(int x, int y, int w, int h, int first, bool clockwise)
+{
+    GDS::Point box[4] = { GDS::Point(x, y), GDS::Point(x + w, y),
+                          GDS::Point(x + w, y + h), GDS::Point(x, y + h) };
+    std::vector<GDS::Point> pts;
+    for (int i = 0; i < 4; i++)
+        pts.push_back(box[(first + (clockwise ? 4 - i : i)) % 4]);
+    pts.push_back(pts[0]);
+    return pts;
+}
+
+int main()
+{
+    std::string file_name = "rectboundary.gds";
+    std::string msg;
+    std::vector<std::vector<GDS::Point> > orders;
+    for (int first = 0; first < 4; first++)
+    {
+        for (bool clockwise : { false, true })
+            orders.push_back(corners(-300, 200, 1000, 50, first, clockwise));
+    }
+    // Not rectangles: a triangle closed on 5 points, and a bow tie.
+    std::vector<GDS::Point> triangle = { GDS::Point(0, 0), GDS::Point(10, 0), GDS::Point(5, 5),
+                                         GDS::Point(0, 0), GDS::Point(0, 0) };
+    std::vector<GDS::Point> bow_tie = { GDS::Point(0, 0), GDS::Point(10, 10), GDS::Point(10, 0),
+                                        GDS::Point(0, 10), GDS::Point(0, 0) };
+
+    {
+        GDS::Library gds;
+        std::shared_ptr<GDS::Structure> cell = gds.Add("RECTS");
+        for (size_t i = 0; i < orders.size(); i++)
+        {
+            std::shared_ptr<GDS::Boundary> rect = std::make_shared<GDS::Boundary>();
+            rect->set_xy(orders[i]);
+            rect->set_layer(short(i));
+            rect->set_data_type(0);
+            check(rect->is_rect(), "order " + std::to_string(i) + " is stored as a box");
+            check(samePoints(rect->xy(), orders[i]), "order " + std::to_string(i) + " keeps its points");
+            cell->Add(rect);
+        }
+        for (auto *pts : { &triangle, &bow_tie })
+        {
+            std::shared_ptr<GDS::Boundary> polygon = std::make_shared<GDS::Boundary>();
+            polygon->set_rect(GDS::Box(0, 0, 1, 1));
+            polygon->set_xy(*pts);
+            polygon->set_layer(100);
+            polygon->set_data_type(0);
+            check(!polygon->is_rect(), "a polygon is not a box");
+            check(samePoints(polygon->xy(), *pts), "a polygon keeps its points");
+            cell->Add(polygon);
+        }
+        std::ofstream out(file_name, std::ofstream::binary);
+        check(gds.write(out, msg) == 0, "write the library");
+    }
+
+    GDS::Library gds;
+    check(gds.read(file_name, msg) == 0, "read the library");
+    std::shared_ptr<GDS::Structure> cell = gds.get("RECTS");
+    check(cell && cell->size() == orders.size() + 2, "read every boundary");
+    if (!cell || cell->size() != orders.size() + 2)
+        return 1;
+    for (size_t i = 0; i < orders.size(); i++)
+    {
+        auto rect = std::dynamic_pointer_cast<GDS::Boundary>(cell->get(int(i)));
+        check(rect && rect->is_rect(), "order " + std::to_string(i) + " is read as a box");
+        check(rect && samePoints(rect->xy(), orders[i]),
+              "order " + std::to_string(i) + " is read in its order");
+        int x, y, w, h;
+        check(rect && rect->bbox(x, y, w, h) && x == -300 && y == 200 && w == 1000 && h == 50,
+              "order " + std::to_string(i) + " has the box as bounds");
+    }
+    auto triangle_read = std::dynamic_pointer_cast<GDS::Boundary>(cell->get(int(orders.size())));
+    auto bow_tie_read = std::dynamic_pointer_cast<GDS::Boundary>(cell->get(int(orders.size() + 1)));
+    check(triangle_read && !triangle_read->is_rect() && samePoints(triangle_read->xy(), triangle),
+          "the triangle is read as a polygon");
+    check(bow_tie_read && !bow_tie_read->is_rect() && samePoints(bow_tie_read->xy(), bow_tie),
+          "the bow tie is read as a polygon");
+
+    std::remove(file_name.c_str());
+
+    if (failures == 0)
+        std::cout << "rectboundary: passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+// Checks RTree::query against a scan of all the boxes, for sizes around the
+// fanout and its powers, with degenerate boxes, windows touching the boxes
+// only on an edge and coordinates near the ends of the int range.
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "rtree.h"
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static std::vector<int> scan(const std::vector<GDS::Box> &boxes, const std::vector<int> &items,
+                             const GDS::Box &window)
+{
+    std::vector<int> found;
+    for (size_t i = 0; i < std::min(boxes.size(), items.size()); i++)
+    {
+        if (boxes[i].intersects(window))
+            found.push_back(items[i]);
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+static void compare(const GDS::RTree &tree, const std::vector<GDS::Box> &boxes,
+                    const std::vector<int> &items, const GDS::Box &window, const std::string &what)
+{
+    std::vector<int> found;
+    tree.query(window, found);
+    std::sort(found.begin(), found.end());
+    check(found == scan(boxes, items, window), what);
+}
+
+int main()
+{
+    std::mt19937 random(12345);
+    const int F = GDS::RTree::Fanout;
+    for (size_t count : { size_t(0), size_t(1), size_t(F - 1), size_t(F), size_t(F + 1),
+                          size_t(F * F - 1), size_t(F * F), size_t(F * F + 1), size_t(5000) })
+    {
+        std::string what = std::to_string(count) + " boxes";
+        std::uniform_int_distribution<int> coord(-100000, 100000);
+        std::uniform_int_distribution<int> size(0, 3000);
+        std::vector<GDS::Box> boxes;
+        std::vector<int> items;
+        for (size_t i = 0; i < count; i++)
+        {
+            // Every seventh box is a point or a line.
+            int w = i % 7 == 0 ? 0 : size(random);
+            int h = i % 7 == 0 ? 0 : size(random);
+            boxes.emplace_back(coord(random), coord(random), w, h);
+            items.push_back(int(i) * 3 + 7);
+        }
+        GDS::RTree tree;
+        tree.build(boxes, items);
+        check(tree.size() == count, what + ": size");
+
+        for (int q = 0; q < 200; q++)
+        {
+            GDS::Box window(coord(random), coord(random), size(random) * 10, size(random) * 10);
+            compare(tree, boxes, items, window, what + ": random window");
+        }
+        compare(tree, boxes, items, GDS::Box(-200000, -200000, 400000, 400000), what + ": everything");
+        compare(tree, boxes, items, GDS::Box(500000, 500000, 10, 10), what + ": nothing");
+        for (size_t i = 0; i < count; i += 97)
+        {
+            const GDS::Box &b = boxes[i];
+            compare(tree, boxes, items, GDS::Box(b.x + b.w, b.y + b.h, 5, 5), what + ": corner");
+            compare(tree, boxes, items, GDS::Box(b.x - 5, b.y, 5, 0), what + ": left edge");
+            compare(tree, boxes, items, GDS::Box(b.x, b.y, 0, 0), what + ": origin point");
+        }
+    }
+
+    // Items shorter than boxes index only the boxes which have an item.
+    {
+        std::vector<GDS::Box> boxes = { GDS::Box(0, 0, 10, 10), GDS::Box(20, 0, 10, 10), GDS::Box(40, 0, 10, 10) };
+        std::vector<int> items = { 1, 2 };
+        GDS::RTree tree;
+        tree.build(boxes, items);
+        check(tree.size() == 2, "short items: size");
+        compare(tree, boxes, items, GDS::Box(0, 0, 100, 100), "short items");
+    }
+
+    // Coordinates at the ends of the int range do not overflow the window.
+    {
+        std::vector<GDS::Box> boxes = { GDS::Box(INT_MAX - 10, INT_MAX - 10, 10, 10),
+                                        GDS::Box(INT_MIN, INT_MIN, 10, 10), GDS::Box(0, 0, 1, 1) };
+        std::vector<int> items = { 0, 1, 2 };
+        GDS::RTree tree;
+        tree.build(boxes, items);
+        compare(tree, boxes, items, GDS::Box(INT_MAX - 5, INT_MAX - 5, 1000, 1000), "int range: top");
+        compare(tree, boxes, items, GDS::Box(INT_MIN, INT_MIN, 5, 5), "int range: bottom");
+        compare(tree, boxes, items, GDS::Box(INT_MIN, INT_MIN, INT_MAX, INT_MAX), "int range: lower half");
+    }
+
+    // Building again replaces the content.
+    {
+        GDS::RTree tree;
+        std::vector<GDS::Box> boxes = { GDS::Box(0, 0, 10, 10) };
+        std::vector<int> items = { 42 };
+        tree.build(boxes, items);
+        tree.build(std::vector<GDS::Box>(), std::vector<int>());
+        std::vector<int> found;
+        tree.query(GDS::Box(0, 0, 10, 10), found);
+        check(tree.size() == 0 && found.empty(), "rebuild");
+    }
+
+    if (failures == 0)
+        std::cout << "rtree: passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
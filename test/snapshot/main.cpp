@@ -0,0 +1,138 @@
+// Saves a library as a snapshot, opens it back and checks that it writes the
+// same GDSII stream as the library it was made from, and that a snapshot is
+// refused once its source file has changed.
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include "library.h"
+#include "structures.h"
+#include "boundary.h"
+#include "path.h"
+#include "text.h"
+#include "sref.h"
+#include "aref.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static std::vector<char> load(const std::string &file_name)
+{
+    std::ifstream in(file_name, std::ifstream::binary);
+    return std::vector<char>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static bool save(GDS::Library &gds, const std::string &file_name)
+{
+    std::string msg;
+    std::ofstream out(file_name, std::ofstream::binary);
+    return gds.write(out, msg) == 0 && !out.fail();
+}
+
+static void fill(GDS::Library &gds)
+{
+    std::shared_ptr<GDS::Structure> leaf = gds.Add("LEAF");
+    std::shared_ptr<GDS::Boundary> polygon = std::make_shared<GDS::Boundary>();
+    polygon->set_xy({ GDS::Point(0, 0), GDS::Point(100, 0), GDS::Point(50, 80), GDS::Point(0, 0) });
+    polygon->set_layer(1);
+    polygon->set_data_type(2);
+    leaf->Add(polygon);
+    std::shared_ptr<GDS::Path> wire = std::make_shared<GDS::Path>();
+    wire->set_xy({ GDS::Point(0, 0), GDS::Point(0, 500), GDS::Point(300, 500) });
+    wire->set_layer(3);
+    wire->set_width(20);
+    leaf->Add(wire);
+    std::shared_ptr<GDS::Text> label = std::make_shared<GDS::Text>();
+    label->set_layer(4);
+    label->set_string("leaf");
+    label->set_xy(GDS::Point(10, 10));
+    leaf->Add(label);
+
+    std::shared_ptr<GDS::Structure> top = gds.Add("TOP");
+    std::shared_ptr<GDS::SRef> sref = std::make_shared<GDS::SRef>();
+    sref->set_struct_name("LEAF");
+    sref->set_xy(GDS::Point(1000, 2000));
+    sref->set_angle(90);
+    sref->set_mag(2);
+    top->Add(sref);
+    std::shared_ptr<GDS::ARef> aref = std::make_shared<GDS::ARef>();
+    aref->set_struct_name("LEAF");
+    aref->set_row_col(3, 4);
+    aref->set_xy({ GDS::Point(0, 0), GDS::Point(4000, 0), GDS::Point(0, 3000) });
+    top->Add(aref);
+}
+
+int main()
+{
+    std::string source_name = "snapshot_source.gds";
+    std::string snap_name = "snapshot_source.snap";
+    std::string out_name = "snapshot_out.gds";
+    std::string msg;
+
+    {
+        GDS::Library gds;
+        fill(gds);
+        check(save(gds, source_name), "write the source library");
+    }
+    GDS::Library source;
+    check(source.read(source_name, msg) == 0, "read the source library");
+    check(source.write_snapshot(snap_name, source_name, msg) == 0, "write the snapshot");
+    check(save(source, source_name + ".expected"), "write the expected stream");
+
+    {
+        GDS::Library snap;
+        check(snap.open_snapshot(snap_name, source_name, msg) == 0, "open the snapshot");
+        check(snap.size() == source.size(), "the snapshot lists the structures");
+        check(save(snap, out_name), "write the snapshot library");
+        check(load(out_name) == load(source_name + ".expected"), "the streams are the same");
+
+        std::shared_ptr<GDS::Structure> top = snap.get("TOP");
+        check(top && top->size() == 2, "the structures are loaded");
+        if (top)
+        {
+            auto sref = std::dynamic_pointer_cast<GDS::SRef>(top->get(0));
+            check(sref && sref->reference() == snap.get("LEAF"), "the references are linked");
+        }
+    }
+
+    // A structure loaded after its library is gone is built, not linked.
+    std::shared_ptr<GDS::Structure> orphan;
+    {
+        GDS::Library snap;
+        check(snap.open_snapshot(snap_name, source_name, msg) == 0, "open the snapshot again");
+        orphan = snap.get("TOP");
+    }
+    check(orphan && orphan->size() == 2, "load a structure of a destroyed library");
+    orphan.reset();
+
+    // Touch the source: one more structure changes its size.
+    {
+        GDS::Library gds;
+        fill(gds);
+        gds.Add("EXTRA");
+        check(save(gds, source_name), "rewrite the source library");
+    }
+    GDS::Library stale;
+    check(stale.open_snapshot(snap_name, source_name, msg) == GDS::FILE_ERROR,
+          "a stale snapshot is refused");
+
+    std::remove(source_name.c_str());
+    std::remove((source_name + ".expected").c_str());
+    std::remove(snap_name.c_str());
+    std::remove(out_name.c_str());
+
+    if (failures == 0)
+        std::cout << "snapshot: passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
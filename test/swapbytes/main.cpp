@@ -0,0 +1,62 @@
+// Checks swapBytes32, which uses AVX2 or SSSE3 when the CPU has them,
+// against a plain byte reversal, over counts which leave a scalar tail of
+// every length, from unaligned buffers and in place.
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "gdsio.h"
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static void reference(const GDS::Byte *src, GDS::Byte *dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int k = 0; k < 4; k++)
+            dst[4 * i + k] = src[4 * i + 3 - k];
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(7);
+    const size_t kMaxCount = 100;
+    std::vector<GDS::Byte> input(4 * kMaxCount + 8);
+    for (auto &byte : input)
+        byte = GDS::Byte(rng());
+
+    for (size_t offset = 0; offset < 4; offset++)
+    {
+        for (size_t count = 0; count <= kMaxCount; count++)
+        {
+            std::string what = std::to_string(count) + " words at offset " + std::to_string(offset);
+            const GDS::Byte *src = input.data() + offset;
+            std::vector<GDS::Byte> expected(4 * count + 8, 0xaa);
+            std::vector<GDS::Byte> actual(4 * count + 8, 0xaa);
+            reference(src, expected.data() + offset, count);
+            GDS::swapBytes32(src, actual.data() + offset, count);
+            // The bytes around the output are not touched either.
+            check(expected == actual, what);
+
+            std::vector<GDS::Byte> in_place(src, src + 4 * count);
+            GDS::swapBytes32(in_place.data(), in_place.data(), count);
+            check(count == 0 || memcmp(in_place.data(), expected.data() + offset, 4 * count) == 0,
+                  what + " in place");
+        }
+    }
+
+    if (failures == 0)
+        std::cout << "swapbytes: passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -12,7 +12,7 @@ TARGET = test
 TEMPLATE = app
 
 SOURCES += main.cpp
-CONFIG += c++11
+CONFIG += c++17
 
 
 HEADERS  +=
@@ -0,0 +1,111 @@
+// Edits a cell over and over while its tiles are being rendered, quiescing
+// the renderer before each edit, and checks that the tiles drawn at the end
+// show the last edit and none of the earlier ones.
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+#include "library.h"
+#include "structures.h"
+#include "boundary.h"
+#include "renderer.h"
+#include "techfile.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+// The cell spans [0, 2048) in both axes, drawn at a quarter of its size.
+static QImage render(GDS::TileRenderer &renderer)
+{
+    QImage image(512, 512, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setTransform(QTransform(0.25, 0, 0, 0.25, 0, 0));
+    renderer.draw(painter, QRectF(0, 0, 2048, 2048));
+    painter.end();
+    return image;
+}
+
+// Whether any pixel of columns [x0, x1) is drawn.
+static bool painted(const QImage &image, int x0, int x1)
+{
+    for (int y = 0; y < image.height(); y++)
+    {
+        for (int x = x0; x < x1; x++)
+        {
+            if (qAlpha(image.pixel(x, y)) != 0)
+                return true;
+        }
+    }
+    return false;
+}
+
+int main()
+{
+    GDS::Techfile::instance().AddLayer(1, 0);
+    GDS::Library gds;
+    std::shared_ptr<GDS::Structure> cell = gds.Add("TOP");
+    std::shared_ptr<GDS::Boundary> box = std::make_shared<GDS::Boundary>();
+    box->set_layer(1);
+    box->set_data_type(0);
+    box->set_rect(GDS::Box(100, 100, 800, 800));
+    cell->Add(box);
+
+    GDS::TileRenderer renderer(cell, 4);
+    std::shared_ptr<GDS::Boundary> extra;
+    for (int i = 0; i < 50; i++)
+    {
+        render(renderer);
+        // Edit in place, and add or remove an element, while tiles are queued.
+        renderer.quiesce();
+        box->set_rect(GDS::Box(100 + (i % 5) * 10, 100, 800, 800));
+        cell->Invalidate();
+        if (extra)
+        {
+            cell->Del(extra);
+            extra.reset();
+        }
+        else
+        {
+            extra = std::make_shared<GDS::Boundary>();
+            extra->set_layer(1);
+            extra->set_data_type(0);
+            extra->set_rect(GDS::Box(200, 200, 100, 100));
+            cell->Add(extra);
+        }
+    }
+
+    // Move everything to the right half.
+    renderer.quiesce();
+    box->set_rect(GDS::Box(1200, 100, 800, 800));
+    cell->Invalidate();
+    if (extra)
+        cell->Del(extra);
+
+    // Draw until every tile of the view is ready and the image settles.
+    QImage image, last;
+    for (int i = 0; i < 500; i++)
+    {
+        image = render(renderer);
+        if (painted(image, 300, 512) && image == last)
+            break;
+        last = image;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    check(painted(image, 300, 512), "the last edit is drawn");
+    check(!painted(image, 0, 256), "no tile of an earlier edit is drawn");
+
+    if (failures == 0)
+        std::cout << "tilerender: passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
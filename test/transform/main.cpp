@@ -0,0 +1,119 @@
+// Checks Transform against the QTransform chain it replaced, reflect * mag *
+// rotate * translate in Qt's row vector order, written out here in doubles:
+// the matrix, the mapping of points, the inverse and the composition, for
+// Manhattan and arbitrary angles, with and without reflection.
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "transform.h"
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+struct Matrix
+{
+    double a, b, c, d, dx, dy;
+};
+
+// The QTransform chain, as x' = a * x + b * y + dx, y' = c * x + d * y + dy.
+static Matrix QtOrder(GDS::Point offset, double mag, double angle, bool reflect)
+{
+    double radians = angle * 3.14159265358979323846 / 180;
+    double cs = std::cos(radians);
+    double sn = std::sin(radians);
+    double flip = reflect ? -1 : 1;
+    return { mag * cs, -mag * sn * flip, mag * sn, mag * cs * flip, double(offset.x), double(offset.y) };
+}
+
+static bool near(double a, double b)
+{
+    return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(b));
+}
+
+static bool close(GDS::Point p, double x, double y, double tolerance)
+{
+    return std::fabs(p.x - x) <= tolerance && std::fabs(p.y - y) <= tolerance;
+}
+
+int main()
+{
+    std::vector<GDS::Point> points = { GDS::Point(0, 0), GDS::Point(1, 0), GDS::Point(0, 1),
+                                       GDS::Point(1234, -5678), GDS::Point(-99999, 77777) };
+    std::vector<GDS::Point> offsets = { GDS::Point(0, 0), GDS::Point(500, -300), GDS::Point(-100000, 2000000) };
+    for (double angle : { 0.0, 90.0, 180.0, 270.0, -90.0, 450.0, 30.0, 45.0, 123.25 })
+    {
+        for (double mag : { 1.0, 2.0, 0.5 })
+        {
+            for (bool reflect : { false, true })
+            {
+                for (GDS::Point offset : offsets)
+                {
+                    std::string what = "angle " + std::to_string(angle) + " mag " + std::to_string(mag)
+                        + (reflect ? " reflected" : "") + " at " + std::to_string(offset.x) + ","
+                        + std::to_string(offset.y);
+                    GDS::Transform t(offset, mag, angle, reflect);
+                    Matrix m = QtOrder(offset, mag, angle, reflect);
+                    bool manhattan = mag == 1.0 && std::fmod(angle, 90.0) == 0;
+                    check(t.manhattan() == manhattan, what + ": exactness");
+                    check(near(t.a(), m.a) && near(t.b(), m.b) && near(t.c(), m.c) && near(t.d(), m.d)
+                          && near(t.dx(), m.dx) && near(t.dy(), m.dy), what + ": matrix");
+
+                    GDS::Transform inverse = t.inverted();
+                    for (GDS::Point p : points)
+                    {
+                        double x = m.a * p.x + m.b * p.y + m.dx;
+                        double y = m.c * p.x + m.d * p.y + m.dy;
+                        GDS::Point mapped = t.map(p);
+                        check(close(mapped, x, y, manhattan ? 1e-6 : 0.5 + 1e-6), what + ": map");
+                        GDS::Point back = inverse.map(mapped);
+                        // Rounding the mapped point loses up to half a unit, scaled back.
+                        check(close(back, p.x, p.y, manhattan ? 1e-6 : 1.0 / mag + 0.5), what + ": inverse");
+                    }
+
+                    GDS::Transform child(GDS::Point(7, -11), 1.0, 90.0, true);
+                    GDS::Transform composed = t * child;
+                    for (GDS::Point p : points)
+                    {
+                        GDS::Point inner = child.map(p);
+                        double x = m.a * inner.x + m.b * inner.y + m.dx;
+                        double y = m.c * inner.x + m.d * inner.y + m.dy;
+                        check(close(composed.map(p), x, y, manhattan ? 1e-6 : 0.5 + 1e-6), what + ": compose");
+                    }
+
+                    int bx = -50, by = 20, bw = 300, bh = 40;
+                    t.mapBox(bx, by, bw, bh);
+                    double llx = 1e300, lly = 1e300, urx = -1e300, ury = -1e300;
+                    for (GDS::Point corner : { GDS::Point(-50, 20), GDS::Point(250, 20),
+                                               GDS::Point(250, 60), GDS::Point(-50, 60) })
+                    {
+                        double x = m.a * corner.x + m.b * corner.y + m.dx;
+                        double y = m.c * corner.x + m.d * corner.y + m.dy;
+                        llx = std::min(llx, x);
+                        lly = std::min(lly, y);
+                        urx = std::max(urx, x);
+                        ury = std::max(ury, y);
+                    }
+                    // The reference corners carry the rounding error of cos and sin.
+                    double e = 1e-6;
+                    check(bx <= llx + e && by <= lly + e && bx + bw >= urx - e && by + bh >= ury - e
+                          && bx > llx - 1 - e && by > lly - 1 - e && bx + bw < urx + 1 + e && by + bh < ury + 1 + e,
+                          what + ": box");
+                }
+            }
+        }
+    }
+
+    if (failures == 0)
+        std::cout << "transform: passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}